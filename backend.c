@@ -49,6 +49,8 @@
 #include "helper_thread.h"
 #include "pshared.h"
 #include "zone-dist.h"
+#include "corpus.h"
+#include "numa_place.h"
 
 static struct fio_sem *startup_sem;
 static struct flist_head *cgroup_list;
@@ -73,7 +75,6 @@ pthread_mutex_t overlap_check = PTHREAD_ERRORCHECK_MUTEX_INITIALIZER_NP;
 pthread_mutex_t overlap_check = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
-#define JOB_START_TIMEOUT	(5 * 1000)
 
 static void sig_int(int sig)
 {
@@ -1220,6 +1221,33 @@ cleanup:
 	return 1;
 }
 
+/*
+ * Generate the data pool that buffers are filled from, for the
+ * buffer_compress_mode settings other than pad. With buffer_corpus, use
+ * the shared corpus that was generated before the job was started.
+ */
+static int init_compress_pool(struct thread_data *td)
+{
+	struct thread_options *o = &td->o;
+
+	if (td->buffer_corpus) {
+		td->compress_pool = *td->buffer_corpus;
+		return 0;
+	}
+
+	if (o->compress_mode == COMPRESS_MODE_PAD || !o->compress_percentage)
+		return 0;
+
+	if (compress_pool_init(&td->compress_pool, o->compress_mode,
+				o->compress_percentage,
+				td->rand_seeds[FIO_RAND_BUF_OFF])) {
+		log_err("fio: failed to allocate compression data pool\n");
+		return 1;
+	}
+
+	return 0;
+}
+
 static void cleanup_io_u(struct thread_data *td)
 {
 	struct io_u *io_u;
@@ -1620,12 +1648,14 @@ static void *thread_main(void *data)
 	struct thread_options *o = &td->o;
 	struct sk_out *sk_out = fd->sk_out;
 	uint64_t bytes_done[DDIR_RWDIR_CNT];
+	struct timespec phase_start;
 	int deadlock_loop_cnt;
 	bool clear_state;
 	int res, ret;
 
 	sk_out_assign(sk_out);
 	free(fd);
+	td->startup_usec[FIO_STARTUP_SPAWN] = utime_since_now(&td->spawn_time);
 
 	if (!o->use_thread) {
 		setsid();
@@ -1657,12 +1687,8 @@ static void *thread_main(void *data)
 		goto err;
 	}
 
-	td_set_runstate(td, TD_INITIALIZED);
 	dprint(FD_MUTEX, "up startup_sem\n");
 	fio_sem_up(startup_sem);
-	dprint(FD_MUTEX, "wait on td->sem\n");
-	fio_sem_down(td->sem);
-	dprint(FD_MUTEX, "done waiting on td->sem\n");
 
 	/*
 	 * A new gid requires privilege, so we need to do this before setting
@@ -1767,6 +1793,9 @@ static void *thread_main(void *data)
 	}
 #endif
 
+	if (fio_numa_place_job(td))
+		goto err;
+
 	if (fio_pin_memory(td))
 		goto err;
 
@@ -1777,8 +1806,14 @@ static void *thread_main(void *data)
 	if (!init_iolog(td))
 		goto err;
 
+	fio_gettime(&phase_start, NULL);
 	if (td_io_init(td))
 		goto err;
+	td->startup_usec[FIO_STARTUP_ENGINE] = utime_since_now(&phase_start);
+
+	fio_gettime(&phase_start, NULL);
+	if (init_compress_pool(td))
+		goto err;
 
 	if (init_io_u(td))
 		goto err;
@@ -1786,6 +1821,9 @@ static void *thread_main(void *data)
 	if (td->io_ops->post_init && td->io_ops->post_init(td))
 		goto err;
 
+	fio_numa_place_memory(td);
+	td->startup_usec[FIO_STARTUP_BUFFERS] = utime_since_now(&phase_start);
+
 	if (o->verify_async && verify_async_init(td))
 		goto err;
 
@@ -1811,23 +1849,39 @@ static void *thread_main(void *data)
 	if (o->ioscheduler && switch_ioscheduler(td))
 		goto err;
 
+	fio_gettime(&phase_start, NULL);
 	if (!o->create_serialize && setup_files(td))
 		goto err;
 
 	if (!init_random_map(td))
 		goto err;
 
+	if (init_active_files(td)) {
+		log_err("fio: failed allocating active file set\n");
+		goto err;
+	}
+
 	if (o->exec_prerun && exec_string(o, o->exec_prerun, "prerun"))
 		goto err;
 
 	if (o->pre_read && !pre_read_files(td))
 		goto err;
+	td->startup_usec[FIO_STARTUP_FILES] = utime_since_now(&phase_start);
 
 	fio_verify_init(td);
 
 	if (rate_submit_init(td, sk_out))
 		goto err;
 
+	/*
+	 * Setup is done. Wait for the other jobs started with us, so they
+	 * all begin I/O at the same time.
+	 */
+	td_set_runstate(td, TD_INITIALIZED);
+	dprint(FD_MUTEX, "wait on td->sem\n");
+	fio_sem_down(td->sem);
+	dprint(FD_MUTEX, "done waiting on td->sem\n");
+
 	set_epoch_time(td, o->log_unix_epoch);
 	fio_getrusage(&td->ru_start);
 	memcpy(&td->bw_sample_time, &td->epoch, sizeof(td->epoch));
@@ -1993,6 +2047,7 @@ err:
 
 	close_and_free_files(td);
 	cleanup_io_u(td);
+	compress_pool_exit(&td->compress_pool);
 	close_ioengine(td);
 	cgroup_shutdown(td, cgroup_mnt);
 	verify_free_state(td);
@@ -2283,12 +2338,55 @@ static bool waitee_running(struct thread_data *me)
 /*
  * Main function for kicking off and reaping jobs, as needed.
  */
+/*
+ * Summarize where the time went starting a batch of jobs. Only shown if
+ * it took a while, the rest of the time it's a debug message.
+ */
+static void show_startup_stats(int nr_jobs, struct timespec *start,
+			       uint64_t spawn_usec, uint64_t layout_usec)
+{
+	uint64_t max[FIO_STARTUP_NR] = { 0, };
+	struct thread_data *td;
+	uint64_t total_usec;
+	char buf[256];
+	int i, j;
+
+	if (!nr_jobs)
+		return;
+
+	for_each_td(td, i) {
+		if (td->runstate != TD_INITIALIZED)
+			continue;
+		for (j = 0; j < FIO_STARTUP_NR; j++)
+			max[j] = max(max[j], td->startup_usec[j]);
+	}
+
+	total_usec = utime_since_now(start) + layout_usec;
+
+	snprintf(buf, sizeof(buf), "fio: started %d job%s in %.2fs: layout "
+		"%.2fs, spawn %.2fs, setup %.2fs; slowest job: spawn %.3fs, "
+		"engine %.3fs, buffers %.3fs, files %.3fs\n",
+		nr_jobs, nr_jobs > 1 ? "s" : "", total_usec / 1000000.0,
+		layout_usec / 1000000.0, spawn_usec / 1000000.0,
+		(total_usec - layout_usec - spawn_usec) / 1000000.0,
+		max[FIO_STARTUP_SPAWN] / 1000000.0,
+		max[FIO_STARTUP_ENGINE] / 1000000.0,
+		max[FIO_STARTUP_BUFFERS] / 1000000.0,
+		max[FIO_STARTUP_FILES] / 1000000.0);
+
+	if ((output_format & FIO_OUTPUT_NORMAL) && total_usec >= 1000000)
+		log_info("%s", buf);
+	else
+		dprint(FD_PROCESS, "%s", buf);
+}
+
 static void run_threads(struct sk_out *sk_out)
 {
 	struct thread_data *td;
 	unsigned int i, todo, nr_running, nr_started;
 	uint64_t m_rate, t_rate;
-	uint64_t spent;
+	uint64_t spent, layout_usec;
+	struct timespec layout_start;
 
 	if (fio_gtod_offload && fio_start_gtod_thread())
 		return;
@@ -2301,6 +2399,8 @@ static void run_threads(struct sk_out *sk_out)
 	for_each_td(td, i) {
 		if (check_mount_writes(td))
 			return;
+		if (buffer_corpus_setup(td))
+			return;
 		if (td->o.use_thread)
 			nr_thread++;
 		else
@@ -2331,6 +2431,7 @@ static void run_threads(struct sk_out *sk_out)
 	nr_started = 0;
 	m_rate = t_rate = 0;
 
+	fio_gettime(&layout_start, NULL);
 	for_each_td(td, i) {
 		print_status_init(td->thread_number - 1);
 
@@ -2369,6 +2470,8 @@ reap:
 		}
 	}
 
+	layout_usec = utime_since_now(&layout_start);
+
 	/* start idle threads before io threads start to run */
 	fio_idle_prof_start();
 
@@ -2379,10 +2482,13 @@ reap:
 		struct timespec this_start;
 		int this_jobs = 0, left;
 		struct fork_data *fd;
+		uint64_t spawn_usec;
 
 		/*
-		 * create threads (TD_NOT_CREATED -> TD_CREATED)
+		 * create threads (TD_NOT_CREATED -> TD_CREATED). They are
+		 * all spawned first and set themselves up in parallel.
 		 */
+		fio_gettime(&this_start, NULL);
 		for_each_td(td, i) {
 			if (td->runstate != TD_NOT_CREATED)
 				continue;
@@ -2431,6 +2537,7 @@ reap:
 			fd = calloc(1, sizeof(*fd));
 			fd->td = td;
 			fd->sk_out = sk_out;
+			fio_gettime(&td->spawn_time, NULL);
 
 			if (td->o.use_thread) {
 				int ret;
@@ -2461,32 +2568,36 @@ reap:
 					_exit(ret);
 				} else if (i == fio_debug_jobno)
 					*fio_debug_jobp = pid;
+				free(fd);
 			}
+		}
+
+		/*
+		 * Each job checks in once it's running, before its setup.
+		 */
+		for (i = 0; i < this_jobs; i++) {
 			dprint(FD_MUTEX, "wait on startup_sem\n");
 			if (fio_sem_down_timeout(startup_sem, 10000)) {
 				log_err("fio: job startup hung? exiting.\n");
 				fio_terminate_threads(TERMINATE_ALL, TERMINATE_ALL);
 				fio_abort = true;
-				nr_started--;
-				free(fd);
 				break;
 			}
 			dprint(FD_MUTEX, "done waiting on startup_sem\n");
 		}
+		spawn_usec = utime_since_now(&this_start);
 
 		/*
-		 * Wait for the started threads to transition to
-		 * TD_INITIALIZED.
+		 * Wait for the started threads to finish their setup and
+		 * transition to TD_INITIALIZED. Setup can legitimately take
+		 * long (file layout, pre_read), so there's no timeout here,
+		 * but a process that died on the way is noticed.
 		 */
-		fio_gettime(&this_start, NULL);
 		left = this_jobs;
 		while (left && !fio_abort) {
-			if (mtime_since_now(&this_start) > JOB_START_TIMEOUT)
-				break;
-
-			do_usleep(100000);
-
 			for (i = 0; i < this_jobs; i++) {
+				int status;
+
 				td = map[i];
 				if (!td)
 					continue;
@@ -2498,8 +2609,16 @@ reap:
 					left--;
 					todo--;
 					nr_running++; /* work-around... */
+				} else if (!td->o.use_thread &&
+					   waitpid(td->pid, &status, WNOHANG) == td->pid) {
+					log_err("fio: pid=%d died during setup\n",
+							(int) td->pid);
+					td_set_runstate(td, TD_EXITED);
 				}
 			}
+
+			if (left)
+				do_usleep(10000);
 		}
 
 		if (left) {
@@ -2517,6 +2636,9 @@ reap:
 		/*
 		 * start created threads (TD_INITIALIZED -> TD_RUNNING).
 		 */
+		show_startup_stats(this_jobs, &this_start, spawn_usec,
+					layout_usec);
+		layout_usec = 0;
 		for_each_td(td, i) {
 			if (td->runstate != TD_INITIALIZED)
 				continue;
@@ -2623,6 +2745,7 @@ int fio_backend(struct sk_out *sk_out)
 	}
 
 	free_disk_util();
+	buffer_corpus_exit();
 	if (cgroup_list) {
 		cgroup_kill(cgroup_list);
 		sfree(cgroup_list);
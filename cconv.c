@@ -45,6 +45,7 @@ static void free_thread_options_to_cpu(struct thread_options *o)
 	free(o->exec_prerun);
 	free(o->exec_postrun);
 	free(o->ioscheduler);
+	free(o->random_pattern);
 	free(o->profile);
 	free(o->cgroup);
 
@@ -82,6 +83,7 @@ void convert_thread_options_to_cpu(struct thread_options *o,
 	string_to_cpu(&o->exec_prerun, top->exec_prerun);
 	string_to_cpu(&o->exec_postrun, top->exec_postrun);
 	string_to_cpu(&o->ioscheduler, top->ioscheduler);
+	string_to_cpu(&o->random_pattern, top->random_pattern);
 	string_to_cpu(&o->profile, top->profile);
 	string_to_cpu(&o->cgroup, top->cgroup);
 
@@ -160,6 +162,7 @@ void convert_thread_options_to_cpu(struct thread_options *o,
 	o->create_fsync = le32_to_cpu(top->create_fsync);
 	o->create_on_open = le32_to_cpu(top->create_on_open);
 	o->create_only = le32_to_cpu(top->create_only);
+	o->layout_threads = le32_to_cpu(top->layout_threads);
 	o->end_fsync = le32_to_cpu(top->end_fsync);
 	o->pre_read = le32_to_cpu(top->pre_read);
 	o->sync_io = le32_to_cpu(top->sync_io);
@@ -209,6 +212,7 @@ void convert_thread_options_to_cpu(struct thread_options *o,
 	o->gauss_dev.u.f = fio_uint64_to_double(le64_to_cpu(top->gauss_dev.u.i));
 	o->random_center.u.f = fio_uint64_to_double(le64_to_cpu(top->random_center.u.i));
 	o->random_generator = le32_to_cpu(top->random_generator);
+	o->random_partition = le32_to_cpu(top->random_partition);
 	o->hugepage_size = le32_to_cpu(top->hugepage_size);
 	o->rw_min_bs = le64_to_cpu(top->rw_min_bs);
 	o->thinktime = le32_to_cpu(top->thinktime);
@@ -253,6 +257,7 @@ void convert_thread_options_to_cpu(struct thread_options *o,
 	o->numjobs = le32_to_cpu(top->numjobs);
 	o->cpus_allowed_policy = le32_to_cpu(top->cpus_allowed_policy);
 	o->gpu_dev_id = le32_to_cpu(top->gpu_dev_id);
+	o->numa_placement = le32_to_cpu(top->numa_placement);
 	o->iolog = le32_to_cpu(top->iolog);
 	o->rwmixcycle = le32_to_cpu(top->rwmixcycle);
 	o->nice = le32_to_cpu(top->nice);
@@ -300,9 +305,13 @@ void convert_thread_options_to_cpu(struct thread_options *o,
 	o->latency_run = le32_to_cpu(top->latency_run);
 	o->compress_percentage = le32_to_cpu(top->compress_percentage);
 	o->compress_chunk = le32_to_cpu(top->compress_chunk);
+	o->compress_mode = le32_to_cpu(top->compress_mode);
+	o->buffer_corpus = le32_to_cpu(top->buffer_corpus);
 	o->dedupe_percentage = le32_to_cpu(top->dedupe_percentage);
 	o->dedupe_mode = le32_to_cpu(top->dedupe_mode);
 	o->dedupe_working_set_percentage = le32_to_cpu(top->dedupe_working_set_percentage);
+	o->dedupe_variant = le32_to_cpu(top->dedupe_variant);
+	o->dedupe_similar_bits = le32_to_cpu(top->dedupe_similar_bits);
 	o->block_error_hist = le32_to_cpu(top->block_error_hist);
 	o->replay_align = le32_to_cpu(top->replay_align);
 	o->replay_scale = le32_to_cpu(top->replay_scale);
@@ -361,6 +370,7 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	string_to_net(top->exec_prerun, o->exec_prerun);
 	string_to_net(top->exec_postrun, o->exec_postrun);
 	string_to_net(top->ioscheduler, o->ioscheduler);
+	string_to_net(top->random_pattern, o->random_pattern);
 	string_to_net(top->profile, o->profile);
 	string_to_net(top->cgroup, o->cgroup);
 
@@ -394,6 +404,7 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->create_fsync = cpu_to_le32(o->create_fsync);
 	top->create_on_open = cpu_to_le32(o->create_on_open);
 	top->create_only = cpu_to_le32(o->create_only);
+	top->layout_threads = cpu_to_le32(o->layout_threads);
 	top->end_fsync = cpu_to_le32(o->end_fsync);
 	top->pre_read = cpu_to_le32(o->pre_read);
 	top->sync_io = cpu_to_le32(o->sync_io);
@@ -437,6 +448,7 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->gauss_dev.u.i = __cpu_to_le64(fio_double_to_uint64(o->gauss_dev.u.f));
 	top->random_center.u.i = __cpu_to_le64(fio_double_to_uint64(o->random_center.u.f));
 	top->random_generator = cpu_to_le32(o->random_generator);
+	top->random_partition = cpu_to_le32(o->random_partition);
 	top->hugepage_size = cpu_to_le32(o->hugepage_size);
 	top->rw_min_bs = __cpu_to_le64(o->rw_min_bs);
 	top->thinktime = cpu_to_le32(o->thinktime);
@@ -459,6 +471,7 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->numjobs = cpu_to_le32(o->numjobs);
 	top->cpus_allowed_policy = cpu_to_le32(o->cpus_allowed_policy);
 	top->gpu_dev_id = cpu_to_le32(o->gpu_dev_id);
+	top->numa_placement = cpu_to_le32(o->numa_placement);
 	top->iolog = cpu_to_le32(o->iolog);
 	top->rwmixcycle = cpu_to_le32(o->rwmixcycle);
 	top->nice = cpu_to_le32(o->nice);
@@ -506,9 +519,13 @@ void convert_thread_options_to_net(struct thread_options_pack *top,
 	top->latency_run = __cpu_to_le32(o->latency_run);
 	top->compress_percentage = cpu_to_le32(o->compress_percentage);
 	top->compress_chunk = cpu_to_le32(o->compress_chunk);
+	top->compress_mode = cpu_to_le32(o->compress_mode);
+	top->buffer_corpus = cpu_to_le32(o->buffer_corpus);
 	top->dedupe_percentage = cpu_to_le32(o->dedupe_percentage);
 	top->dedupe_mode = cpu_to_le32(o->dedupe_mode);
 	top->dedupe_working_set_percentage = cpu_to_le32(o->dedupe_working_set_percentage);
+	top->dedupe_variant = cpu_to_le32(o->dedupe_variant);
+	top->dedupe_similar_bits = cpu_to_le32(o->dedupe_similar_bits);
 	top->block_error_hist = cpu_to_le32(o->block_error_hist);
 	top->replay_align = cpu_to_le32(o->replay_align);
 	top->replay_scale = cpu_to_le32(o->replay_scale);
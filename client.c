@@ -1263,6 +1263,8 @@ static void convert_jobs_eta(struct jobs_eta *je)
 
 	je->elapsed_sec		= le64_to_cpu(je->elapsed_sec);
 	je->eta_sec		= le64_to_cpu(je->eta_sec);
+	je->layout_done		= le64_to_cpu(je->layout_done);
+	je->layout_total	= le64_to_cpu(je->layout_total);
 	je->nr_threads		= le32_to_cpu(je->nr_threads);
 	je->is_pow2		= le32_to_cpu(je->is_pow2);
 	je->unit_base		= le32_to_cpu(je->unit_base);
@@ -1289,6 +1291,8 @@ void fio_client_sum_jobs_eta(struct jobs_eta *dst, struct jobs_eta *je)
 	}
 
 	dst->elapsed_sec	+= je->elapsed_sec;
+	dst->layout_done	+= je->layout_done;
+	dst->layout_total	+= je->layout_total;
 
 	if (je->eta_sec > dst->eta_sec)
 		dst->eta_sec = je->eta_sec;
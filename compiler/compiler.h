@@ -15,6 +15,16 @@
 
 #define fio_unlikely(x)	__builtin_expect(!!(x), 0)
 
+/*
+ * Keep gcc from auto-vectorizing a function, for loops where the vector
+ * version is slower than the scalar one (eg 64-bit multiplies).
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+#define fio_novector	__attribute__((optimize("no-tree-vectorize")))
+#else
+#define fio_novector
+#endif
+
 /*
  * Check at compile time that something is of a particular type.
  * Always evaluates to 1 so you may use it easily in comparisons.
@@ -0,0 +1,207 @@
+/*
+ * Buffer corpus: a block of deterministic data that write buffers are
+ * copied out of, instead of being generated for every IO. The corpus has
+ * the compression properties of the job baked in, and is generated once
+ * in the parent before the jobs are started. Jobs that want the same kind
+ * of data share the same corpus. It is never written after it has been
+ * generated, so forked jobs share the same physical (huge) pages.
+ *
+ * Buffers are copied out through compress_pool_fill(), so each one is
+ * taken from a seed dependent offset with a seed dependent byte
+ * substitution applied. Dedupe works as before, since the same seed gives
+ * the same buffer.
+ */
+#include <string.h>
+#include <sys/mman.h>
+
+#include "fio.h"
+#include "corpus.h"
+#include "flist.h"
+#include "lib/rand.h"
+
+struct corpus_key {
+	unsigned int size;
+	unsigned int mode;
+	unsigned int percentage;
+	unsigned int segment;
+	unsigned int pattern_bytes;
+	char pattern[MAX_PATTERN_SIZE];
+	uint64_t seed;
+};
+
+struct buffer_corpus {
+	struct flist_head list;
+	struct corpus_key key;
+	struct compress_pool cp;
+	size_t map_size;
+};
+
+static FLIST_HEAD(corpus_list);
+
+static void corpus_key_init(struct thread_data *td, struct corpus_key *key)
+{
+	struct thread_options *o = &td->o;
+
+	memset(key, 0, sizeof(*key));
+	key->size = o->buffer_corpus;
+	key->seed = o->rand_seed;
+	key->percentage = o->compress_percentage;
+	if (!key->percentage)
+		return;
+
+	key->mode = o->compress_mode;
+	if (key->mode != COMPRESS_MODE_PAD)
+		return;
+
+	/*
+	 * Padded buffers are filled in segments of the size fill_io_buffer()
+	 * uses, and the corpus has to be made of segments of the same size.
+	 */
+	key->segment = min_not_zero(o->min_bs[DDIR_WRITE],
+				(unsigned long long) o->compress_chunk);
+	key->pattern_bytes = o->buffer_pattern_bytes;
+	memcpy(key->pattern, o->buffer_pattern, o->buffer_pattern_bytes);
+
+	key->size = max(key->size, 2 * key->segment);
+	key->size = (key->size + key->segment - 1) / key->segment * key->segment;
+}
+
+/*
+ * Try hugetlb pages first, then fall back to normal pages with a
+ * transparent huge page hint.
+ */
+static void *corpus_map(struct thread_data *td, size_t *size)
+{
+	void *p;
+
+#ifdef MAP_HUGETLB
+	if (td->o.hugepage_size) {
+		size_t mask = td->o.hugepage_size - 1;
+		size_t huge_size = (*size + mask) & ~mask;
+
+		p = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | OS_MAP_ANON | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED) {
+			dprint(FD_MEM, "corpus: %zu bytes in hugetlb pages\n",
+					huge_size);
+			*size = huge_size;
+			return p;
+		}
+	}
+#endif
+
+	p = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | OS_MAP_ANON,
+			-1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+
+#ifdef CONFIG_HAVE_THP
+	/* Ignore errors on this optional advisory */
+	madvise(p, *size, MADV_HUGEPAGE);
+#endif
+	return p;
+}
+
+static void corpus_generate(struct buffer_corpus *bc)
+{
+	struct corpus_key *key = &bc->key;
+	struct compress_pool *cp = &bc->cp;
+	struct frand_state fs;
+	unsigned int off;
+
+	cp->align = 1;
+
+	if (!key->percentage) {
+		__fill_random_buf(cp->buf, cp->size, key->seed);
+		return;
+	} else if (key->mode != COMPRESS_MODE_PAD) {
+		compress_pool_generate(cp->buf, cp->size, key->mode,
+					key->percentage, key->seed);
+		return;
+	}
+
+	init_rand_seed(&fs, key->seed, true);
+	for (off = 0; off < cp->size; off += key->segment) {
+		__fill_random_buf_percentage(__get_next_seed(&fs),
+				cp->buf + off, key->percentage, key->segment,
+				key->segment, key->pattern, key->pattern_bytes);
+	}
+	cp->align = key->segment;
+}
+
+static struct buffer_corpus *corpus_new(struct thread_data *td,
+					struct corpus_key *key)
+{
+	struct buffer_corpus *bc;
+	struct timespec start;
+
+	bc = calloc(1, sizeof(*bc));
+	if (!bc)
+		return NULL;
+
+	bc->key = *key;
+	bc->map_size = key->size;
+	bc->cp.buf = corpus_map(td, &bc->map_size);
+	if (!bc->cp.buf) {
+		free(bc);
+		return NULL;
+	}
+	bc->cp.size = key->size;
+	bc->cp.shared = true;
+
+	fio_gettime(&start, NULL);
+	corpus_generate(bc);
+	mprotect(bc->cp.buf, bc->map_size, PROT_READ);
+	dprint(FD_MEM, "corpus: generated %u bytes in %llu msec\n",
+			key->size, (unsigned long long) mtime_since_now(&start));
+
+	flist_add_tail(&bc->list, &corpus_list);
+	return bc;
+}
+
+/*
+ * Find or generate the corpus for this job. Must be called before the
+ * job is started.
+ */
+int buffer_corpus_setup(struct thread_data *td)
+{
+	struct buffer_corpus *bc;
+	struct corpus_key key;
+	struct flist_head *n;
+
+	td->buffer_corpus = NULL;
+	if (!td->o.buffer_corpus)
+		return 0;
+
+	corpus_key_init(td, &key);
+
+	flist_for_each(n, &corpus_list) {
+		bc = flist_entry(n, struct buffer_corpus, list);
+		if (!memcmp(&bc->key, &key, sizeof(key))) {
+			td->buffer_corpus = &bc->cp;
+			return 0;
+		}
+	}
+
+	bc = corpus_new(td, &key);
+	if (!bc) {
+		log_err("fio: failed to allocate buffer corpus of %u bytes\n",
+				key.size);
+		return 1;
+	}
+
+	td->buffer_corpus = &bc->cp;
+	return 0;
+}
+
+void buffer_corpus_exit(void)
+{
+	struct buffer_corpus *bc;
+
+	while (!flist_empty(&corpus_list)) {
+		bc = flist_first_entry(&corpus_list, struct buffer_corpus, list);
+		flist_del(&bc->list);
+		munmap(bc->cp.buf, bc->map_size);
+		free(bc);
+	}
+}
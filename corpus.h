@@ -0,0 +1,9 @@
+#ifndef FIO_CORPUS_H
+#define FIO_CORPUS_H
+
+struct thread_data;
+
+int buffer_corpus_setup(struct thread_data *td);
+void buffer_corpus_exit(void);
+
+#endif
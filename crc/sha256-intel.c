@@ -0,0 +1,123 @@
+#include "sha256.h"
+#include "../arch/arch.h"
+
+/*
+ * SHA-256 block transform using the x86 SHA extensions (SHA-NI). Based on
+ * the public domain reference by Sean Gulley and Jeffrey Walton. The state
+ * is kept in the ABEF/CDGH register layout the sha256rnds2 instruction
+ * expects for the whole run of blocks, and only shuffled back to the
+ * regular layout once at the end.
+ */
+
+bool sha256_intel_available = false;
+
+#ifdef ARCH_HAVE_SHA_NI
+
+#include <immintrin.h>
+
+static bool sha256_probed;
+
+static const uint32_t K[64] __attribute__((aligned(16))) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+__attribute__((target("sha,sse4.1")))
+void sha256_intel_blocks(uint32_t *state, const uint8_t *data,
+			 unsigned int blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, msg, tmp;
+	__m128i w[4];
+	int i;
+
+	tmp = _mm_loadu_si128((const __m128i *) &state[0]);
+	state1 = _mm_loadu_si128((const __m128i *) &state[4]);
+
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);		/* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1B);	/* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8);	/* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);	/* CDGH */
+
+	while (blocks--) {
+		abef = state0;
+		cdgh = state1;
+
+		/*
+		 * 16 groups of 4 rounds. The message schedule for group
+		 * i + 1 is finished while group i runs, and started two
+		 * groups ahead, so w[] only ever holds four live vectors.
+		 */
+		for (i = 0; i < 16; i++) {
+			if (i < 4) {
+				msg = _mm_loadu_si128((const __m128i *) (data + 16 * i));
+				w[i] = _mm_shuffle_epi8(msg, mask);
+			}
+
+			msg = _mm_add_epi32(w[i & 3],
+				_mm_load_si128((const __m128i *) &K[4 * i]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+
+			if (i >= 3 && i < 15) {
+				tmp = _mm_alignr_epi8(w[i & 3], w[(i - 1) & 3], 4);
+				w[(i + 1) & 3] = _mm_add_epi32(w[(i + 1) & 3], tmp);
+				w[(i + 1) & 3] = _mm_sha256msg2_epu32(w[(i + 1) & 3],
+								      w[i & 3]);
+			}
+
+			msg = _mm_shuffle_epi32(msg, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+			if (i >= 1 && i < 13)
+				w[(i - 1) & 3] = _mm_sha256msg1_epu32(w[(i - 1) & 3],
+								      w[i & 3]);
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+		data += SHA256_BLOCK_SIZE;
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);		/* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1);	/* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);	/* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8);	/* ABEF */
+
+	_mm_storeu_si128((__m128i *) &state[0], state0);
+	_mm_storeu_si128((__m128i *) &state[4], state1);
+}
+
+void sha256_intel_probe(void)
+{
+	if (!sha256_probed) {
+		unsigned int eax, ebx, ecx = 0, edx;
+		bool sse41;
+
+		eax = 1;
+		do_cpuid(&eax, &ebx, &ecx, &edx);
+		sse41 = (ecx & (1 << 19)) != 0;
+
+		eax = 7;
+		ecx = 0;
+		do_cpuid(&eax, &ebx, &ecx, &edx);
+		sha256_intel_available = sse41 && (ebx & (1 << 29)) != 0;
+		sha256_probed = true;
+	}
+}
+
+#endif /* ARCH_HAVE_SHA_NI */
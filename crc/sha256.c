@@ -226,6 +226,20 @@ static void sha256_transform(uint32_t *state, const uint8_t *input)
 	memset(W, 0, 64 * sizeof(uint32_t));
 }
 
+static void sha256_blocks(uint32_t *state, const uint8_t *input,
+			  unsigned int blocks)
+{
+	if (sha256_intel_available) {
+		sha256_intel_blocks(state, input, blocks);
+		return;
+	}
+
+	while (blocks--) {
+		sha256_transform(state, input);
+		input += SHA256_BLOCK_SIZE;
+	}
+}
+
 void fio_sha256_init(struct fio_sha256_ctx *sctx)
 {
 	sctx->state[0] = H0;
@@ -242,7 +256,7 @@ void fio_sha256_init(struct fio_sha256_ctx *sctx)
 void fio_sha256_update(struct fio_sha256_ctx *sctx, const uint8_t *data,
 		       unsigned int len)
 {
-	unsigned int partial, done;
+	unsigned int partial, done, blocks;
 	const uint8_t *src;
 
 	partial = sctx->count & 0x3f;
@@ -254,15 +268,17 @@ void fio_sha256_update(struct fio_sha256_ctx *sctx, const uint8_t *data,
 		if (partial) {
 			done = -partial;
 			memcpy(sctx->buf + partial, data, done + 64);
-			src = sctx->buf;
+			sha256_blocks(sctx->state, sctx->buf, 1);
+			done += 64;
 		}
 
-		do {
-			sha256_transform(sctx->state, src);
-			done += 64;
-			src = data + done;
-		} while (done + 63 < len);
+		blocks = (len - done) / SHA256_BLOCK_SIZE;
+		if (blocks) {
+			sha256_blocks(sctx->state, data + done, blocks);
+			done += blocks * SHA256_BLOCK_SIZE;
+		}
 
+		src = data + done;
 		partial = 0;
 	}
 	memcpy(sctx->buf + partial, src, len - done);
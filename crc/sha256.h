@@ -3,6 +3,8 @@
 
 #include <inttypes.h>
 
+#include "../lib/types.h"
+
 #define SHA256_DIGEST_SIZE	32
 #define SHA256_BLOCK_SIZE	64
 
@@ -16,4 +18,19 @@ void fio_sha256_init(struct fio_sha256_ctx *);
 void fio_sha256_update(struct fio_sha256_ctx *, const uint8_t *, unsigned int);
 void fio_sha256_final(struct fio_sha256_ctx *);
 
+extern bool sha256_intel_available;
+
+#ifdef ARCH_HAVE_SHA_NI
+extern void sha256_intel_blocks(uint32_t *, const uint8_t *, unsigned int);
+extern void sha256_intel_probe(void);
+#else
+static inline void sha256_intel_blocks(uint32_t *state, const uint8_t *data,
+				       unsigned int blocks)
+{
+}
+static inline void sha256_intel_probe(void)
+{
+}
+#endif
+
 #endif
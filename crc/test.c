@@ -333,6 +333,22 @@ static struct test_type t[] = {
 	},
 };
 
+/*
+ * Whether the runtime probe picked a hardware accelerated implementation
+ * for this checksum, so the numbers can be told apart across hosts.
+ */
+static bool hw_accel(struct test_type *t)
+{
+	switch (t->mask) {
+	case T_CRC32C:
+		return crc32c_intel_available || crc32c_arm64_available;
+	case T_SHA256:
+		return sha256_intel_available;
+	default:
+		return false;
+	}
+}
+
 static unsigned int get_test_mask(const char *type)
 {
 	char *ostr, *str = strdup(type);
@@ -375,6 +391,7 @@ int fio_crctest(const char *type)
 
 	crc32c_arm64_probe();
 	crc32c_intel_probe();
+	sha256_intel_probe();
 
 	if (!type)
 		test_mask = ~0U;
@@ -421,7 +438,9 @@ int fio_crctest(const char *type)
 				sprintf(pre, "\t");
 			else
 				sprintf(pre, "\t\t");
-			printf("%s:%s%8.2f MiB/sec\n", t[i].name, pre, mb_sec);
+			printf("%s:%s%8.2f MiB/sec\t%6.2f GB/sec%s\n", t[i].name,
+				pre, mb_sec, (double) mb / (usec * 1000.0),
+				hw_accel(&t[i]) ? "\t(hw)" : "");
 		} else
 			printf("%s:inf MiB/sec\n", t[i].name);
 		first = 0;
@@ -455,6 +455,9 @@ bool calc_thread_status(struct jobs_eta *je, int force)
 		else if (td->runstate < TD_RUNNING)
 			je->nr_pending++;
 
+		je->layout_done += td->layout_bytes_done;
+		je->layout_total += td->layout_bytes_total;
+
 		if (je->elapsed_sec >= 3)
 			eta_secs[i] = thread_eta(td);
 		else
@@ -523,7 +526,7 @@ bool calc_thread_status(struct jobs_eta *je, int force)
 
 	memcpy(&disp_prev_time, &now, sizeof(now));
 
-	if (!force && !je->nr_running && !je->nr_pending)
+	if (!force && !je->nr_running && !je->nr_pending && !je->layout_total)
 		return false;
 
 	je->nr_threads = thread_number;
@@ -594,6 +597,14 @@ void display_thread_status(struct jobs_eta *je)
 
 	p += sprintf(p, "Jobs: %d (f=%d)", je->nr_running, je->files_open);
 
+	/* file layout progress, if any job is still laying out */
+	if (je->layout_total) {
+		double layout_perc;
+
+		layout_perc = (double) je->layout_done / (double) je->layout_total;
+		p += sprintf(p, ", layout %3.1f%%", 100.0 * min(layout_perc, 1.0));
+	}
+
 	/* rate limits, if any */
 	if (je->m_rate[0] || je->m_rate[1] || je->m_rate[2] ||
 	    je->t_rate[0] || je->t_rate[1] || je->t_rate[2]) {
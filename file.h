@@ -8,7 +8,9 @@
 #include "lib/zipf.h"
 #include "lib/axmap.h"
 #include "lib/lfsr.h"
+#include "lib/feistel.h"
 #include "lib/gauss.h"
+#include "lib/access_pattern.h"
 
 /* Forward declarations */
 struct zoned_block_device_info;
@@ -34,6 +36,7 @@ enum fio_file_flags {
 	FIO_FILE_axmap		= 1 << 7,	/* uses axmap */
 	FIO_FILE_lfsr		= 1 << 8,	/* lfsr is used */
 	FIO_FILE_smalloc	= 1 << 9,	/* smalloc file/file_name */
+	FIO_FILE_feistel	= 1 << 10,	/* feistel permutation is used */
 };
 
 enum file_lock_mode {
@@ -142,24 +145,31 @@ struct fio_file {
 	};
 
 	/*
-	 * block map or LFSR for random io
+	 * block map, LFSR or permutation for random io
 	 */
 	union {
 		struct axmap *io_axmap;
-		struct fio_lfsr lfsr;
+		struct fio_lfsr *lfsr;
+		struct fio_feistel *feistel;
 	};
 
 	/*
-	 * Used for zipf random distribution
+	 * Used for zipf random distribution. Allocated only when used, to
+	 * keep the file small for jobs with many files.
 	 */
 	union {
-		struct zipf_state zipf;
-		struct gauss_state gauss;
+		struct zipf_state *zipf;
+		struct gauss_state *gauss;
+		struct apat_state *apat;
 	};
 
 	int references;
 	enum fio_file_flags flags;
 
+	/* index into td->active_files and td->open_file_set */
+	unsigned int active_index;
+	unsigned int open_index;
+
 	struct disk_util *du;
 };
 
@@ -190,6 +200,7 @@ FILE_FLAG_FNS(partial_mmap);
 FILE_FLAG_FNS(axmap);
 FILE_FLAG_FNS(lfsr);
 FILE_FLAG_FNS(smalloc);
+FILE_FLAG_FNS(feistel);
 #undef FILE_FLAG_FNS
 
 /*
@@ -230,6 +241,11 @@ extern void free_release_files(struct thread_data *);
 extern void filesetup_mem_free(void);
 extern void fio_file_reset(struct thread_data *, struct fio_file *);
 extern bool fio_files_done(struct thread_data *);
+extern int init_active_files(struct thread_data *);
+extern void reset_active_files(struct thread_data *);
+extern void fio_file_mark_done(struct thread_data *, struct fio_file *);
+extern void fio_file_add_open(struct thread_data *, struct fio_file *);
+extern void fio_file_remove_open(struct thread_data *, struct fio_file *);
 extern bool exists_and_not_regfile(const char *);
 extern int fio_set_directio(struct thread_data *, struct fio_file *);
 extern void fio_file_free(struct fio_file *);
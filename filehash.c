@@ -6,24 +6,61 @@
 #include "hash.h"
 #include "filehash.h"
 #include "smalloc.h"
+#include "pshared.h"
 #include "lib/bloom.h"
 
-#define HASH_BUCKETS	512
-#define HASH_MASK	(HASH_BUCKETS - 1)
+/*
+ * The file hash is shared between all jobs. Rather than a single lock
+ * around a fixed size table, each bucket belongs to one of HASH_STRIPES
+ * lock stripes (the low bits of the hash), so lookups and inserts of
+ * different files rarely contend. The table doubles in size when the
+ * average chain gets long; resizing takes every stripe lock in order.
+ */
+#define HASH_STRIPES		64
+#define HASH_STRIPE_MASK	(HASH_STRIPES - 1)
+#define HASH_MIN_BUCKETS	512
+#define HASH_MAX_BUCKETS	(256 * 1024)
+#define HASH_LOAD_FACTOR	2
 
 #define BLOOM_SIZE	16*1024*1024
 
-static unsigned int file_hash_size = HASH_BUCKETS * sizeof(struct flist_head);
-
-static struct flist_head *file_hash;
+struct file_hash_stripe {
+	pthread_mutex_t lock;
+	unsigned int nr_entries;
+	/* keep neighbouring stripes off each other's cache lines */
+	char pad[64 - (sizeof(pthread_mutex_t) + sizeof(unsigned int)) % 64];
+};
+
+struct file_hash_table {
+	struct file_hash_stripe stripes[HASH_STRIPES];
+	struct flist_head *buckets;
+	unsigned int nr_buckets;
+	unsigned int mask;
+};
+
+static struct file_hash_table *file_hash;
 static struct fio_sem *hash_lock;
 static struct bloom *file_bloom;
 
-static unsigned short hash(const char *name)
+static uint32_t hash(const char *name)
+{
+	return jhash(name, strlen(name), 0);
+}
+
+static struct file_hash_stripe *hash_stripe(uint32_t h)
 {
-	return jhash(name, strlen(name), 0) & HASH_MASK;
+	return &file_hash->stripes[h & HASH_STRIPE_MASK];
 }
 
+static struct flist_head *hash_bucket(uint32_t h)
+{
+	return &file_hash->buckets[h & file_hash->mask];
+}
+
+/*
+ * Serializes users of the already-allocated filename list in filesetup.c,
+ * it does not protect the hash itself.
+ */
 void fio_file_hash_lock(void)
 {
 	if (hash_lock)
@@ -36,22 +73,99 @@ void fio_file_hash_unlock(void)
 		fio_sem_up(hash_lock);
 }
 
+static void lock_all_stripes(void)
+{
+	int i;
+
+	for (i = 0; i < HASH_STRIPES; i++)
+		pthread_mutex_lock(&file_hash->stripes[i].lock);
+}
+
+static void unlock_all_stripes(void)
+{
+	int i;
+
+	for (i = HASH_STRIPES - 1; i >= 0; i--)
+		pthread_mutex_unlock(&file_hash->stripes[i].lock);
+}
+
+static bool hash_needs_grow(struct file_hash_stripe *s)
+{
+	if (file_hash->nr_buckets >= HASH_MAX_BUCKETS)
+		return false;
+
+	return s->nr_entries * HASH_STRIPES >
+		HASH_LOAD_FACTOR * file_hash->nr_buckets;
+}
+
+static void grow_file_hash(void)
+{
+	struct flist_head *old, *new;
+	unsigned int i, old_nr, new_nr, nr_entries = 0;
+
+	lock_all_stripes();
+
+	/*
+	 * Someone else may have grown the table while we waited for the
+	 * stripe locks, check the overall load again.
+	 */
+	for (i = 0; i < HASH_STRIPES; i++)
+		nr_entries += file_hash->stripes[i].nr_entries;
+
+	old_nr = file_hash->nr_buckets;
+	if (old_nr >= HASH_MAX_BUCKETS ||
+	    nr_entries <= HASH_LOAD_FACTOR * old_nr)
+		goto out;
+
+	new_nr = old_nr * 2;
+	new = smalloc(new_nr * sizeof(struct flist_head));
+	if (!new)
+		goto out;
+
+	for (i = 0; i < new_nr; i++)
+		INIT_FLIST_HEAD(&new[i]);
+
+	old = file_hash->buckets;
+	for (i = 0; i < old_nr; i++) {
+		struct flist_head *n, *tmp;
+
+		flist_for_each_safe(n, tmp, &old[i]) {
+			struct fio_file *f;
+
+			f = flist_entry(n, struct fio_file, hash_list);
+			flist_del(&f->hash_list);
+			flist_add_tail(&f->hash_list,
+				       &new[hash(f->file_name) & (new_nr - 1)]);
+		}
+	}
+
+	file_hash->buckets = new;
+	file_hash->nr_buckets = new_nr;
+	file_hash->mask = new_nr - 1;
+	sfree(old);
+out:
+	unlock_all_stripes();
+}
+
 void remove_file_hash(struct fio_file *f)
 {
-	fio_sem_down(hash_lock);
+	struct file_hash_stripe *s = hash_stripe(hash(f->file_name));
+
+	pthread_mutex_lock(&s->lock);
 
 	if (fio_file_hashed(f)) {
 		assert(!flist_empty(&f->hash_list));
 		flist_del_init(&f->hash_list);
 		fio_file_clear_hashed(f);
+		s->nr_entries--;
 	}
 
-	fio_sem_up(hash_lock);
+	pthread_mutex_unlock(&s->lock);
 }
 
-static struct fio_file *__lookup_file_hash(const char *name)
+static struct fio_file *__lookup_file_hash(const char *name, uint32_t h)
 {
-	struct flist_head *bucket = &file_hash[hash(name)];
+	struct flist_head *bucket = hash_bucket(h);
 	struct flist_head *n;
 
 	flist_for_each(n, bucket) {
@@ -69,32 +183,43 @@ static struct fio_file *__lookup_file_hash(const char *name)
 
 struct fio_file *lookup_file_hash(const char *name)
 {
+	uint32_t h = hash(name);
+	struct file_hash_stripe *s = hash_stripe(h);
 	struct fio_file *f;
 
-	fio_sem_down(hash_lock);
-	f = __lookup_file_hash(name);
-	fio_sem_up(hash_lock);
+	pthread_mutex_lock(&s->lock);
+	f = __lookup_file_hash(name, h);
+	pthread_mutex_unlock(&s->lock);
 	return f;
 }
 
 struct fio_file *add_file_hash(struct fio_file *f)
 {
+	uint32_t h = hash(f->file_name);
+	struct file_hash_stripe *s = hash_stripe(h);
 	struct fio_file *alias;
+	bool grow = false;
 
 	if (fio_file_hashed(f))
 		return NULL;
 
 	INIT_FLIST_HEAD(&f->hash_list);
 
-	fio_sem_down(hash_lock);
+	pthread_mutex_lock(&s->lock);
 
-	alias = __lookup_file_hash(f->file_name);
+	alias = __lookup_file_hash(f->file_name, h);
 	if (!alias) {
 		fio_file_set_hashed(f);
-		flist_add_tail(&f->hash_list, &file_hash[hash(f->file_name)]);
+		flist_add_tail(&f->hash_list, hash_bucket(h));
+		s->nr_entries++;
+		grow = hash_needs_grow(s);
 	}
 
-	fio_sem_up(hash_lock);
+	pthread_mutex_unlock(&s->lock);
+
+	if (grow)
+		grow_file_hash();
+
 	return alias;
 }
 
@@ -107,14 +232,21 @@ void file_hash_exit(void)
 {
 	unsigned int i, has_entries = 0;
 
-	fio_sem_down(hash_lock);
-	for (i = 0; i < HASH_BUCKETS; i++)
-		has_entries += !flist_empty(&file_hash[i]);
-	fio_sem_up(hash_lock);
+	if (!file_hash)
+		return;
+
+	lock_all_stripes();
+	for (i = 0; i < file_hash->nr_buckets; i++)
+		has_entries += !flist_empty(&file_hash->buckets[i]);
+	unlock_all_stripes();
 
 	if (has_entries)
 		log_err("fio: file hash not empty on exit\n");
 
+	for (i = 0; i < HASH_STRIPES; i++)
+		pthread_mutex_destroy(&file_hash->stripes[i].lock);
+
+	sfree(file_hash->buckets);
 	sfree(file_hash);
 	file_hash = NULL;
 	fio_sem_remove(hash_lock);
@@ -127,10 +259,15 @@ void file_hash_init(void)
 {
 	unsigned int i;
 
-	file_hash = smalloc(file_hash_size);
+	file_hash = smalloc(sizeof(*file_hash));
+	file_hash->nr_buckets = HASH_MIN_BUCKETS;
+	file_hash->mask = HASH_MIN_BUCKETS - 1;
+	file_hash->buckets = smalloc(HASH_MIN_BUCKETS * sizeof(struct flist_head));
 
-	for (i = 0; i < HASH_BUCKETS; i++)
-		INIT_FLIST_HEAD(&file_hash[i]);
+	for (i = 0; i < HASH_MIN_BUCKETS; i++)
+		INIT_FLIST_HEAD(&file_hash->buckets[i]);
+	for (i = 0; i < HASH_STRIPES; i++)
+		mutex_init_pshared(&file_hash->stripes[i].lock);
 
 	hash_lock = fio_sem_init(FIO_SEM_UNLOCKED);
 	file_bloom = bloom_new(BLOOM_SIZE);
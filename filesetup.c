@@ -36,6 +36,47 @@ static inline void clear_error(struct thread_data *td)
 	td->verror[0] = '\0';
 }
 
+/*
+ * Layout and prepopulate write this much per write(2), built from
+ * block size sized fills.
+ */
+#define LAYOUT_WRITE_SIZE	(1024 * 1024)
+
+static unsigned long long layout_write_size(unsigned long long bs,
+					    unsigned long long left)
+{
+	unsigned long long ws = bs;
+
+	if (ws && ws < LAYOUT_WRITE_SIZE)
+		ws = (LAYOUT_WRITE_SIZE / bs) * bs;
+
+	return min(ws, left);
+}
+
+/*
+ * Fill a layout buffer one block at a time, so the data looks like what
+ * the job would have written itself. The buffer generation state is shared
+ * between layout threads.
+ */
+static void fill_layout_buffer(struct thread_data *td, char *b,
+			       unsigned long long len, unsigned long long bs)
+{
+	if (td->layout_fill_lock)
+		pthread_mutex_lock(td->layout_fill_lock);
+
+	while (len) {
+		if (bs > len)
+			bs = len;
+
+		fill_io_buffer(td, b, bs, bs);
+		b += bs;
+		len -= bs;
+	}
+
+	if (td->layout_fill_lock)
+		pthread_mutex_unlock(td->layout_fill_lock);
+}
+
 static int native_fallocate(struct thread_data *td, struct fio_file *f)
 {
 	bool success;
@@ -116,11 +157,23 @@ static void fallocate_file(struct thread_data *td, struct fio_file *f)
 /*
  * Leaves f->fd open on success, caller must close
  */
+/*
+ * check if we need to lay the file out complete again. fio
+ * does that for operations involving reads, or for writes
+ * where overwrite is set
+ */
+static bool layout_writes_file(struct thread_data *td)
+{
+	return td_read(td) ||
+	       (td_write(td) && td->o.overwrite && !td->o.file_append) ||
+	       (td_write(td) && td_ioengine_flagged(td, FIO_NOEXTEND));
+}
+
 static int extend_file(struct thread_data *td, struct fio_file *f)
 {
 	int new_layout = 0, unlink_file = 0, flags;
 	unsigned long long left;
-	unsigned long long bs;
+	unsigned long long bs, ws, buf_size = 0;
 	char *b = NULL;
 
 	if (read_only) {
@@ -128,14 +181,7 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 		return 0;
 	}
 
-	/*
-	 * check if we need to lay the file out complete again. fio
-	 * does that for operations involving reads, or for writes
-	 * where overwrite is set
-	 */
-	if (td_read(td) ||
-	   (td_write(td) && td->o.overwrite && !td->o.file_append) ||
-	    (td_write(td) && td_ioengine_flagged(td, FIO_NOEXTEND)))
+	if (layout_writes_file(td))
 		new_layout = 1;
 	if (td_write(td) && !td->o.overwrite && !td->o.file_append)
 		unlink_file = 1;
@@ -203,7 +249,8 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 	if (bs > left)
 		bs = left;
 
-	b = malloc(bs);
+	ws = buf_size = layout_write_size(bs, left);
+	b = fio_memalign(page_size, buf_size, false);
 	if (!b) {
 		td_verror(td, errno, "malloc");
 		goto err;
@@ -212,15 +259,16 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 	while (left && !td->terminate) {
 		ssize_t r;
 
-		if (bs > left)
-			bs = left;
+		if (ws > left)
+			ws = left;
 
-		fill_io_buffer(td, b, bs, bs);
+		fill_layout_buffer(td, b, ws, bs);
 
-		r = write(f->fd, b, bs);
+		r = write(f->fd, b, ws);
 
 		if (r > 0) {
 			left -= r;
+			atomic_add(&td->layout_bytes_done, r);
 			continue;
 		} else {
 			if (r < 0) {
@@ -262,14 +310,14 @@ static int extend_file(struct thread_data *td, struct fio_file *f)
 			f->io_size = f->real_file_size;
 	}
 
-	free(b);
+	fio_memfree(b, buf_size, false);
 done:
 	return 0;
 err:
 	close(f->fd);
 	f->fd = -1;
 	if (b)
-		free(b);
+		fio_memfree(b, buf_size, false);
 	return 1;
 }
 
@@ -351,7 +399,7 @@ error:
 int generic_prepopulate_file(struct thread_data *td, struct fio_file *f)
 {
 	int flags;
-	unsigned long long left, bs;
+	unsigned long long left, bs, ws, buf_size = 0;
 	char *b = NULL;
 
 	/* generic function for regular files only */
@@ -388,7 +436,8 @@ int generic_prepopulate_file(struct thread_data *td, struct fio_file *f)
 	if (bs > left)
 		bs = left;
 
-	b = malloc(bs);
+	ws = buf_size = layout_write_size(bs, left);
+	b = fio_memalign(page_size, buf_size, false);
 	if (!b) {
 		td_verror(td, errno, "malloc");
 		goto err;
@@ -397,15 +446,16 @@ int generic_prepopulate_file(struct thread_data *td, struct fio_file *f)
 	while (left && !td->terminate) {
 		ssize_t r;
 
-		if (bs > left)
-			bs = left;
+		if (ws > left)
+			ws = left;
 
-		fill_io_buffer(td, b, bs, bs);
+		fill_layout_buffer(td, b, ws, bs);
 
-		r = write(f->fd, b, bs);
+		r = write(f->fd, b, ws);
 
 		if (r > 0) {
 			left -= r;
+			atomic_add(&td->layout_bytes_done, r);
 		} else {
 			td_verror(td, errno, "write");
 			goto err;
@@ -422,13 +472,13 @@ int generic_prepopulate_file(struct thread_data *td, struct fio_file *f)
 		}
 	}
 
-	free(b);
+	fio_memfree(b, buf_size, false);
 	return 0;
 err:
 	close(f->fd);
 	f->fd = -1;
 	if (b)
-		free(b);
+		fio_memfree(b, buf_size, false);
 	return 1;
 }
 
@@ -1081,6 +1131,159 @@ static bool create_work_dirs(struct thread_data *td, const char *fname)
 /*
  * Open the files and setup files sizes, creating files if necessary.
  */
+/*
+ * Lay out a file that setup_files() flagged for extension.
+ */
+static int layout_one_file(struct thread_data *td, struct fio_file *f)
+{
+	unsigned long long old_len = -1ULL, extend_len = -1ULL;
+	int err;
+
+	if (!fio_file_extend(f))
+		return 0;
+
+	assert(f->filetype == FIO_TYPE_FILE);
+	fio_file_clear_extend(f);
+	if (!td->o.fill_device) {
+		old_len = f->real_file_size;
+		extend_len = f->io_size + f->file_offset - old_len;
+	}
+	f->real_file_size = (f->io_size + f->file_offset);
+	err = extend_file(td, f);
+	if (err)
+		return err;
+
+	err = __file_invalidate_cache(td, f, old_len, extend_len);
+
+	/*
+	 * Shut up static checker
+	 */
+	if (f->fd != -1)
+		close(f->fd);
+
+	f->fd = -1;
+	return err;
+}
+
+static int prepopulate_one_file(struct thread_data *td, struct fio_file *f)
+{
+	int err;
+
+	if (output_format & FIO_OUTPUT_NORMAL) {
+		log_info("%s: Prepopulating IO file (%s)\n", td->o.name,
+							f->file_name);
+	}
+
+	err = td->io_ops->prepopulate_file(td, f);
+	if (err)
+		return err;
+
+	err = __file_invalidate_cache(td, f, f->file_offset, f->io_size);
+
+	/*
+	 * Shut up static checker
+	 */
+	if (f->fd != -1)
+		close(f->fd);
+
+	f->fd = -1;
+	return err;
+}
+
+struct layout_pool {
+	struct thread_data *td;
+	int (*fn)(struct thread_data *, struct fio_file *);
+	pthread_mutex_t lock;
+	pthread_mutex_t fill_lock;
+	unsigned int next_file;
+	int err;
+};
+
+static void *layout_thread_main(void *data)
+{
+	struct layout_pool *pool = data;
+	struct thread_data *td = pool->td;
+
+	while (!td->terminate) {
+		struct fio_file *f = NULL;
+		int err;
+
+		pthread_mutex_lock(&pool->lock);
+		if (!pool->err && pool->next_file < td->o.nr_files)
+			f = td->files[pool->next_file++];
+		pthread_mutex_unlock(&pool->lock);
+
+		if (!f)
+			break;
+
+		err = pool->fn(td, f);
+		if (err) {
+			pthread_mutex_lock(&pool->lock);
+			if (!pool->err)
+				pool->err = err;
+			pthread_mutex_unlock(&pool->lock);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Run fn for each file of the job. With layout_threads set, files are
+ * handed out to a pool of threads, each writing a different file.
+ */
+static int layout_files(struct thread_data *td, unsigned int nr_work,
+			int (*fn)(struct thread_data *, struct fio_file *))
+{
+	unsigned int i, nr_threads = min(td->o.layout_threads, nr_work);
+	struct layout_pool pool = { .td = td, .fn = fn, };
+	pthread_t *threads;
+	struct fio_file *f;
+	int err = 0;
+
+	if (nr_threads <= 1 || !td->files_index)
+		goto serial;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		goto serial;
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_mutex_init(&pool.fill_lock, NULL);
+	td->layout_fill_lock = &pool.fill_lock;
+
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&threads[i], NULL, layout_thread_main,
+				   &pool)) {
+			log_err("fio: failed to create layout thread\n");
+			break;
+		}
+	}
+	nr_threads = i;
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	td->layout_fill_lock = NULL;
+	pthread_mutex_destroy(&pool.fill_lock);
+	pthread_mutex_destroy(&pool.lock);
+	free(threads);
+
+	/*
+	 * If no thread could be started, nothing was done yet
+	 */
+	if (nr_threads)
+		return pool.err;
+serial:
+	for_each_file(td, f, i) {
+		err = fn(td, f);
+		if (err)
+			break;
+	}
+
+	return err;
+}
+
 int setup_files(struct thread_data *td)
 {
 	unsigned long long total_size, extend_size;
@@ -1309,7 +1512,6 @@ int setup_files(struct thread_data *td)
 	 * initially due to read I/Os.
 	 */
 	if (need_extend) {
-		temp_stall_ts = 1;
 		if (output_format & FIO_OUTPUT_NORMAL) {
 			log_info("%s: Laying out IO file%s (%u file%s / %s%lluMiB)\n",
 				 o->name,
@@ -1320,38 +1522,11 @@ int setup_files(struct thread_data *td)
 				 extend_size >> 20);
 		}
 
-		for_each_file(td, f, i) {
-			unsigned long long old_len = -1ULL, extend_len = -1ULL;
+		if (layout_writes_file(td) && !o->fill_device)
+			td->layout_bytes_total = extend_size;
 
-			if (!fio_file_extend(f))
-				continue;
-
-			assert(f->filetype == FIO_TYPE_FILE);
-			fio_file_clear_extend(f);
-			if (!o->fill_device) {
-				old_len = f->real_file_size;
-				extend_len = f->io_size + f->file_offset -
-						old_len;
-			}
-			f->real_file_size = (f->io_size + f->file_offset);
-			err = extend_file(td, f);
-			if (err)
-				break;
-
-			err = __file_invalidate_cache(td, f, old_len,
-								extend_len);
-
-			/*
-			 * Shut up static checker
-			 */
-			if (f->fd != -1)
-				close(f->fd);
-
-			f->fd = -1;
-			if (err)
-				break;
-		}
-		temp_stall_ts = 0;
+		err = layout_files(td, need_extend, layout_one_file);
+		td->layout_bytes_done = td->layout_bytes_total = 0;
 	}
 
 	if (err)
@@ -1365,29 +1540,11 @@ int setup_files(struct thread_data *td)
 	if (td->io_ops->prepopulate_file) {
 		temp_stall_ts = 1;
 
-		for_each_file(td, f, i) {
-			if (output_format & FIO_OUTPUT_NORMAL) {
-				log_info("%s: Prepopulating IO file (%s)\n",
-							o->name, f->file_name);
-			}
-
-			err = td->io_ops->prepopulate_file(td, f);
-			if (err)
-				break;
+		for_each_file(td, f, i)
+			td->layout_bytes_total += f->real_file_size;
 
-			err = __file_invalidate_cache(td, f, f->file_offset,
-								f->io_size);
-
-			/*
-			 * Shut up static checker
-			 */
-			if (f->fd != -1)
-				close(f->fd);
-
-			f->fd = -1;
-			if (err)
-				break;
-		}
+		err = layout_files(td, td->o.nr_files, prepopulate_one_file);
+		td->layout_bytes_done = td->layout_bytes_total = 0;
 		temp_stall_ts = 0;
 	}
 
@@ -1441,7 +1598,7 @@ bool pre_read_files(struct thread_data *td)
 	return true;
 }
 
-static void __init_rand_distribution(struct thread_data *td, struct fio_file *f)
+static bool __init_rand_distribution(struct thread_data *td, struct fio_file *f)
 {
 	unsigned int range_size, seed;
 	uint64_t nranges;
@@ -1456,32 +1613,107 @@ static void __init_rand_distribution(struct thread_data *td, struct fio_file *f)
 	if (!td->o.rand_repeatable)
 		seed = td->rand_seeds[4];
 
+	if (td->o.random_distribution == FIO_RAND_DIST_PATTERN) {
+		if (!f->apat)
+			f->apat = malloc(sizeof(*f->apat));
+		if (!f->apat)
+			return false;
+		apat_state_init(f->apat, seed);
+		return true;
+	}
+
+	if (td->o.random_distribution == FIO_RAND_DIST_GAUSS) {
+		if (!f->gauss)
+			f->gauss = malloc(sizeof(*f->gauss));
+		if (!f->gauss)
+			return false;
+		gauss_init(f->gauss, nranges, td->o.gauss_dev.u.f, td->o.random_center.u.f, seed);
+		return true;
+	}
+
+	if (!f->zipf)
+		f->zipf = malloc(sizeof(*f->zipf));
+	if (!f->zipf)
+		return false;
+
 	if (td->o.random_distribution == FIO_RAND_DIST_ZIPF)
-		zipf_init(&f->zipf, nranges, td->o.zipf_theta.u.f, td->o.random_center.u.f, seed);
+		zipf_init(f->zipf, nranges, td->o.zipf_theta.u.f, td->o.random_center.u.f, seed);
 	else if (td->o.random_distribution == FIO_RAND_DIST_PARETO)
-		pareto_init(&f->zipf, nranges, td->o.pareto_h.u.f, td->o.random_center.u.f, seed);
-	else if (td->o.random_distribution == FIO_RAND_DIST_GAUSS)
-		gauss_init(&f->gauss, nranges, td->o.gauss_dev.u.f, td->o.random_center.u.f, seed);
+		pareto_init(f->zipf, nranges, td->o.pareto_h.u.f, td->o.random_center.u.f, seed);
+
+	return true;
+}
+
+/*
+ * Compile random_pattern once for the job. The skew of the terms is
+ * resolved against the largest file.
+ */
+static bool init_access_pattern(struct thread_data *td)
+{
+	unsigned int range_size, i;
+	uint64_t nranges = 1;
+	struct fio_file *f;
+	const char *err;
+
+	if (td->access_pattern)
+		return true;
+
+	td->access_pattern = apat_parse(td->o.random_pattern, &err);
+	if (!td->access_pattern) {
+		log_err("fio: random_pattern: %s\n", err);
+		return false;
+	}
+
+	range_size = min(td->o.min_bs[DDIR_READ], td->o.min_bs[DDIR_WRITE]);
+	for_each_file(td, f, i) {
+		uint64_t fsize = min(f->real_file_size, f->io_size);
+
+		nranges = max(nranges, (uint64_t) ((fsize + range_size - 1ULL) / range_size));
+	}
+
+	if (!apat_compile(td->access_pattern, nranges)) {
+		log_err("fio: failed allocating random_pattern tables\n");
+		apat_free(td->access_pattern);
+		td->access_pattern = NULL;
+		return false;
+	}
+
+	return true;
 }
 
-static bool init_rand_distribution(struct thread_data *td)
+/*
+ * Returns 0 if the job uses a uniform distribution, 1 if the non-uniform
+ * distribution was set up, and -1 on failure.
+ */
+static int init_rand_distribution(struct thread_data *td)
 {
 	struct fio_file *f;
 	unsigned int i;
-	int state;
+	int state, ret = 1;
 
 	if (td->o.random_distribution == FIO_RAND_DIST_RANDOM ||
 	    td->o.random_distribution == FIO_RAND_DIST_ZONED ||
 	    td->o.random_distribution == FIO_RAND_DIST_ZONED_ABS)
-		return false;
+		return 0;
 
 	state = td_bump_runstate(td, TD_SETTING_UP);
 
-	for_each_file(td, f, i)
-		__init_rand_distribution(td, f);
+	if (td->o.random_distribution == FIO_RAND_DIST_PATTERN &&
+	    !init_access_pattern(td)) {
+		td_restore_runstate(td, state);
+		return -1;
+	}
+
+	for_each_file(td, f, i) {
+		if (!__init_rand_distribution(td, f)) {
+			log_err("fio: failed allocating random distribution\n");
+			ret = -1;
+			break;
+		}
+	}
 
 	td_restore_runstate(td, state);
-	return true;
+	return ret;
 }
 
 /*
@@ -1521,14 +1753,39 @@ static int check_rand_gen_limits(struct thread_data *td, struct fio_file *f,
 	return 0;
 }
 
+/*
+ * With random_partition, all clones of a job walk the same permutation of
+ * the file, so it has to be keyed by the job's seed option rather than the
+ * per clone seeds. Each clone gets an equal share of the positions.
+ */
+static int init_feistel(struct thread_data *td, struct fio_file *f,
+			uint64_t blocks)
+{
+	uint64_t seed = td->rand_seeds[FIO_RAND_BLOCK_OFF];
+	uint64_t start = 0, end = blocks;
+
+	if (td->o.random_partition && td->nr_subjobs > 1) {
+		uint64_t nr = td->nr_subjobs, idx = td->subjob_number;
+		uint64_t share = blocks / nr, extra = blocks % nr;
+
+		seed = td->o.rand_seed ^ f->fileno;
+		start = share * idx + min(idx, extra);
+		end = start + share + (idx < extra);
+	}
+
+	return feistel_init(f->feistel, blocks, seed, start, end);
+}
+
 bool init_random_map(struct thread_data *td)
 {
 	unsigned long long blocks;
 	struct fio_file *f;
 	unsigned int i;
+	int ret;
 
-	if (init_rand_distribution(td))
-		return true;
+	ret = init_rand_distribution(td);
+	if (ret)
+		return ret > 0;
 	if (!td_random(td))
 		return true;
 
@@ -1548,11 +1805,26 @@ bool init_random_map(struct thread_data *td)
 
 			seed = td->rand_seeds[FIO_RAND_BLOCK_OFF];
 
-			if (!lfsr_init(&f->lfsr, blocks, seed, 0)) {
+			f->lfsr = malloc(sizeof(*f->lfsr));
+			if (f->lfsr && !lfsr_init(f->lfsr, blocks, seed, 0)) {
 				fio_file_set_lfsr(f);
 				continue;
 			} else {
 				log_err("fio: failed initializing LFSR\n");
+				free(f->lfsr);
+				f->lfsr = NULL;
+				return false;
+			}
+		} else if (td->o.random_generator == FIO_RAND_GEN_FEISTEL) {
+			f->feistel = malloc(sizeof(*f->feistel));
+			if (f->feistel && !init_feistel(td, f, blocks)) {
+				fio_file_set_feistel(f);
+				continue;
+			} else {
+				log_err("fio: failed initializing feistel "
+					"permutation\n");
+				free(f->feistel);
+				f->feistel = NULL;
 				return false;
 			}
 		} else if (!td->o.norandommap) {
@@ -1594,6 +1866,11 @@ void fio_file_free(struct fio_file *f)
 {
 	if (fio_file_axmap(f))
 		axmap_free(f->io_axmap);
+	else if (fio_file_lfsr(f))
+		free(f->lfsr);
+	else if (fio_file_feistel(f))
+		free(f->feistel);
+	free(f->zipf);
 	if (!fio_file_smalloc(f)) {
 		free(f->file_name);
 		free(f);
@@ -1626,6 +1903,11 @@ void close_and_free_files(struct thread_data *td)
 			td_io_unlink_file(td, f);
 		}
 
+		if (f->zipf &&
+		    (td->o.random_distribution == FIO_RAND_DIST_ZIPF ||
+		     td->o.random_distribution == FIO_RAND_DIST_PARETO))
+			zipf_free(f->zipf);
+
 		zbd_close_file(f);
 		fio_file_free(f);
 	}
@@ -1633,6 +1915,15 @@ void close_and_free_files(struct thread_data *td)
 	td->o.filename = NULL;
 	free(td->files);
 	free(td->file_locks);
+	free(td->active_files);
+	axmap_free(td->done_files_map);
+	free(td->open_file_set);
+	apat_free(td->access_pattern);
+	td->access_pattern = NULL;
+	td->active_files = NULL;
+	td->done_files_map = NULL;
+	td->open_file_set = NULL;
+	td->nr_active_files = 0;
 	td->files_index = 0;
 	td->files = NULL;
 	td->file_locks = NULL;
@@ -1919,7 +2210,7 @@ int put_file(struct thread_data *td, struct fio_file *f)
 	if (!ret)
 		ret = f_ret;
 
-	td->nr_open_files--;
+	fio_file_remove_open(td, f);
 	fio_file_clear_closing(f);
 	fio_file_clear_open(f);
 	assert(f->fd == -1);
@@ -2099,7 +2390,9 @@ void fio_file_reset(struct thread_data *td, struct fio_file *f)
 	if (fio_file_axmap(f))
 		axmap_reset(f->io_axmap);
 	else if (fio_file_lfsr(f))
-		lfsr_reset(&f->lfsr, td->rand_seeds[FIO_RAND_BLOCK_OFF]);
+		lfsr_reset(f->lfsr, td->rand_seeds[FIO_RAND_BLOCK_OFF]);
+	else if (fio_file_feistel(f))
+		feistel_reset(f->feistel);
 
 	zbd_file_reset(td, f);
 }
@@ -2109,6 +2402,10 @@ bool fio_files_done(struct thread_data *td)
 	struct fio_file *f;
 	unsigned int i;
 
+	if ((td->active_files || td->done_files_map) &&
+	    td->files_index == td->o.nr_files)
+		return !td->nr_active_files;
+
 	for_each_file(td, f, i)
 		if (!fio_file_done(f))
 			return false;
@@ -2116,6 +2413,120 @@ bool fio_files_done(struct thread_data *td)
 	return true;
 }
 
+/*
+ * Keep track of the files that aren't done yet, so that picking the next
+ * file doesn't have to skip over the done ones. file_service_type=random
+ * picks from a dense array of them, and a file that is done is replaced by
+ * the last entry. roundrobin and sequential have to keep the file order,
+ * so they use a map of the done files instead.
+ *
+ * If openfiles is less than nrfiles, also keep a dense array of the open
+ * files. Once the limit is reached, only those can be picked.
+ */
+int init_active_files(struct thread_data *td)
+{
+	unsigned int nr_files = td->o.nr_files;
+	struct fio_file *f;
+	unsigned int i;
+
+	if (!nr_files)
+		return 0;
+
+	if (td->o.open_files < td->files_index) {
+		td->open_file_set = malloc(td->files_index * sizeof(unsigned int));
+		if (!td->open_file_set)
+			return 1;
+
+		td->nr_open_files = 0;
+		for_each_file(td, f, i) {
+			if (fio_file_open(f))
+				fio_file_add_open(td, f);
+		}
+	}
+
+	if (td->o.file_service_type == FIO_FSERVICE_RANDOM) {
+		td->active_files = malloc(nr_files * sizeof(unsigned int));
+		if (!td->active_files)
+			return 1;
+	} else if (td->o.file_service_type == FIO_FSERVICE_RR ||
+		   td->o.file_service_type == FIO_FSERVICE_SEQ) {
+		td->done_files_map = axmap_new(nr_files);
+		if (!td->done_files_map)
+			return 1;
+	}
+
+	reset_active_files(td);
+	return 0;
+}
+
+void reset_active_files(struct thread_data *td)
+{
+	unsigned int i, nr_files;
+	struct fio_file *f;
+
+	if (!td->active_files && !td->done_files_map)
+		return;
+
+	if (td->done_files_map)
+		axmap_reset(td->done_files_map);
+
+	td->nr_active_files = 0;
+	nr_files = min(td->o.nr_files, td->files_index);
+	for (i = 0; i < nr_files; i++) {
+		f = td->files[i];
+		if (fio_file_done(f)) {
+			if (td->done_files_map)
+				axmap_set(td->done_files_map, i);
+			continue;
+		}
+		if (td->active_files) {
+			f->active_index = td->nr_active_files;
+			td->active_files[f->active_index] = i;
+		}
+		td->nr_active_files++;
+	}
+}
+
+void fio_file_add_open(struct thread_data *td, struct fio_file *f)
+{
+	if (td->open_file_set) {
+		f->open_index = td->nr_open_files;
+		td->open_file_set[f->open_index] = f->fileno;
+	}
+	td->nr_open_files++;
+}
+
+void fio_file_remove_open(struct thread_data *td, struct fio_file *f)
+{
+	td->nr_open_files--;
+	if (td->open_file_set) {
+		unsigned int last = td->open_file_set[td->nr_open_files];
+
+		td->open_file_set[f->open_index] = last;
+		td->files[last]->open_index = f->open_index;
+	}
+}
+
+void fio_file_mark_done(struct thread_data *td, struct fio_file *f)
+{
+	fio_file_set_done(f);
+	td->nr_done_files++;
+
+	if ((unsigned int) f->fileno >= td->o.nr_files)
+		return;
+
+	if (td->active_files) {
+		unsigned int last;
+
+		last = td->active_files[--td->nr_active_files];
+		td->active_files[f->active_index] = last;
+		td->files[last]->active_index = f->active_index;
+	} else if (td->done_files_map) {
+		axmap_set(td->done_files_map, f->fileno);
+		td->nr_active_files--;
+	}
+}
+
 /* free memory used in initialization phase only */
 void filesetup_mem_free(void)
 {
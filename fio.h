@@ -34,6 +34,7 @@
 #include "gettime.h"
 #include "oslib/getopt.h"
 #include "lib/rand.h"
+#include "lib/compress_pool.h"
 #include "lib/rbtree.h"
 #include "lib/num2str.h"
 #include "lib/memalign.h"
@@ -156,6 +157,17 @@ enum {
 	THINKTIME_BLOCKS_TYPE_ISSUE = 1,
 };
 
+/*
+ * Job startup phases, timed for the startup summary
+ */
+enum {
+	FIO_STARTUP_SPAWN = 0,
+	FIO_STARTUP_ENGINE,
+	FIO_STARTUP_BUFFERS,
+	FIO_STARTUP_FILES,
+	FIO_STARTUP_NR,
+};
+
 enum {
 	F_ADV_NONE = 0,
 	F_ADV_TYPE,
@@ -188,10 +200,15 @@ struct thread_data {
 	pthread_t thread;
 	unsigned int thread_number;
 	unsigned int subjob_number;
+	unsigned int nr_subjobs;	/* numjobs of the job this was cloned from */
 	unsigned int groupid;
 	struct thread_stat ts __attribute__ ((aligned(8)));
 
 	int client_type;
+	int numa_node;		/* node picked by numa_placement */
+
+	struct timespec spawn_time;
+	uint64_t startup_usec[FIO_STARTUP_NR];
 
 	struct io_log *slat_log;
 	struct io_log *clat_log;
@@ -225,6 +242,16 @@ struct thread_data {
 		unsigned int next_file;
 		struct frand_state next_file_state;
 	};
+
+	/*
+	 * Files that aren't done yet, and the files that are open if
+	 * openfiles is less than nrfiles. See init_active_files()
+	 */
+	unsigned int nr_active_files;
+	unsigned int *active_files;
+	struct axmap *done_files_map;
+	unsigned int *open_file_set;
+	unsigned int next_open_file;
 	union {
 		struct zipf_state next_file_zipf;
 		struct gauss_state next_file_gauss;
@@ -235,6 +262,17 @@ struct thread_data {
 		double gauss_dev;
 	};
 	double random_center;
+	struct access_pattern *access_pattern;
+
+	/*
+	 * File layout/prepopulate progress, shown in the ETA output. The
+	 * fill lock is set while layout_threads workers share the job's
+	 * buffer generation state.
+	 */
+	uint64_t layout_bytes_done;
+	uint64_t layout_bytes_total;
+	pthread_mutex_t *layout_fill_lock;
+
 	int error;
 	int sig;
 	int done;
@@ -242,6 +280,7 @@ struct thread_data {
 	pid_t pid;
 	char *orig_buffer;
 	size_t orig_buffer_size;
+	size_t orig_buffer_mapped;	/* mem=memfdhuge/thp mapping size */
 	volatile int runstate;
 	volatile bool terminate;
 	bool last_was_sync;
@@ -270,6 +309,9 @@ struct thread_data {
 
 	unsigned long long num_unique_pages;
 
+	struct compress_pool compress_pool;
+	struct compress_pool *buffer_corpus;
+
 	struct zone_split_index **zone_state_index;
 	unsigned int num_open_zones;
 
@@ -870,6 +912,7 @@ enum {
 	FIO_RAND_DIST_GAUSS,
 	FIO_RAND_DIST_ZONED,
 	FIO_RAND_DIST_ZONED_ABS,
+	FIO_RAND_DIST_PATTERN,
 };
 
 #define FIO_DEF_ZIPF		1.1
@@ -879,6 +922,7 @@ enum {
 	FIO_RAND_GEN_TAUSWORTHE = 0,
 	FIO_RAND_GEN_LFSR,
 	FIO_RAND_GEN_TAUSWORTHE64,
+	FIO_RAND_GEN_FEISTEL,
 };
 
 enum {
@@ -886,6 +930,12 @@ enum {
 	FIO_CPUS_SPLIT,
 };
 
+enum {
+	FIO_NUMA_PLACE_NONE	= 0,
+	FIO_NUMA_PLACE_CPU,
+	FIO_NUMA_PLACE_DEVICE,
+};
+
 extern void exec_trigger(const char *);
 extern void check_trigger_file(void);
 
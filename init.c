@@ -891,6 +891,30 @@ static int fixup_options(struct thread_data *td)
 			o->refill_buffers = 1;
 			td->flags |= TD_F_REFILL_BUFFERS;
 		}
+
+		/*
+		 * The generated modes have matches that span the whole
+		 * buffer, so fill it as one region unless told otherwise.
+		 */
+		if (o->compress_mode != COMPRESS_MODE_PAD &&
+		    !fio_option_is_set(o, compress_chunk))
+			o->compress_chunk = 0;
+	}
+
+	/*
+	 * Filling from the buffer corpus is just a copy, so refill the
+	 * buffers for every write unless the job file said otherwise.
+	 */
+	if (o->buffer_corpus) {
+		if (o->zero_buffers ||
+		    (o->buffer_pattern_bytes && !o->compress_percentage)) {
+			log_info("fio: buffer_corpus has no effect with "
+				 "zero_buffers or buffer_pattern\n");
+			o->buffer_corpus = 0;
+		} else if (!fio_option_is_set(o, refill_buffers)) {
+			o->refill_buffers = 1;
+			td->flags |= TD_F_REFILL_BUFFERS;
+		}
 	}
 
 	/*
@@ -900,6 +924,12 @@ static int fixup_options(struct thread_data *td)
 	if (o->random_distribution != FIO_RAND_DIST_RANDOM)
 		o->norandommap = 1;
 
+	if (o->random_distribution == FIO_RAND_DIST_PATTERN &&
+	    !o->random_pattern) {
+		log_err("fio: random_distribution=pattern needs random_pattern\n");
+		ret |= 1;
+	}
+
 	/*
 	 * If size is set but less than the min block size, complain
 	 */
@@ -1771,6 +1801,8 @@ static int add_job(struct thread_data *td, const char *jobname, int job_add_num,
 	 * as they don't apply to sub-jobs
 	 */
 	numjobs = o->numjobs;
+	if (numjobs > 1)
+		td->nr_subjobs = numjobs;
 	while (--numjobs) {
 		struct thread_data *td_new = get_new_job(false, td, true, jobname);
 
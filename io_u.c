@@ -98,12 +98,17 @@ static int __get_next_rand_offset(struct thread_data *td, struct fio_file *f,
 		dprint(FD_RANDOM, "off rand %llu\n", (unsigned long long) r);
 
 		*b = lastb * (r / (rand_max(&td->random_state) + 1.0));
+	} else if (td->o.random_generator == FIO_RAND_GEN_FEISTEL) {
+		assert(fio_file_feistel(f));
+
+		if (feistel_next(f->feistel, b))
+			return 1;
 	} else {
 		uint64_t off = 0;
 
 		assert(fio_file_lfsr(f));
 
-		if (lfsr_next(&f->lfsr, &off))
+		if (lfsr_next(f->lfsr, &off))
 			return 1;
 
 		*b = off;
@@ -135,7 +140,7 @@ static int __get_next_rand_offset_zipf(struct thread_data *td,
 				       struct fio_file *f, enum fio_ddir ddir,
 				       uint64_t *b)
 {
-	*b = zipf_next(&f->zipf);
+	*b = zipf_next(f->zipf);
 	return 0;
 }
 
@@ -143,7 +148,7 @@ static int __get_next_rand_offset_pareto(struct thread_data *td,
 					 struct fio_file *f, enum fio_ddir ddir,
 					 uint64_t *b)
 {
-	*b = pareto_next(&f->zipf);
+	*b = pareto_next(f->zipf);
 	return 0;
 }
 
@@ -151,7 +156,22 @@ static int __get_next_rand_offset_gauss(struct thread_data *td,
 					struct fio_file *f, enum fio_ddir ddir,
 					uint64_t *b)
 {
-	*b = gauss_next(&f->gauss);
+	*b = gauss_next(f->gauss);
+	return 0;
+}
+
+static int __get_next_rand_offset_pattern(struct thread_data *td,
+					  struct fio_file *f,
+					  enum fio_ddir ddir, uint64_t *b)
+{
+	uint64_t lastb;
+
+	lastb = last_block(td, f, ddir);
+	if (!lastb)
+		return 1;
+
+	*b = apat_next(td->access_pattern, f->apat, mtime_since_now(&td->epoch),
+			lastb);
 	return 0;
 }
 
@@ -295,6 +315,8 @@ static int get_next_rand_offset(struct thread_data *td, struct fio_file *f,
 		return __get_next_rand_offset_zoned(td, f, ddir, b);
 	else if (td->o.random_distribution == FIO_RAND_DIST_ZONED_ABS)
 		return __get_next_rand_offset_zoned_abs(td, f, ddir, b);
+	else if (td->o.random_distribution == FIO_RAND_DIST_PATTERN)
+		return __get_next_rand_offset_pattern(td, f, ddir, b);
 
 	log_err("fio: unknown random distribution: %d\n", td->o.random_distribution);
 	return 1;
@@ -1194,6 +1216,11 @@ static unsigned int __get_next_fileno_rand(struct thread_data *td)
 		unsigned long r;
 
 		r = __rand(&td->next_file_state);
+		if (td->active_files) {
+			fileno = (double) td->nr_active_files
+					* (r / (frand_max + 1.0));
+			return td->active_files[fileno];
+		}
 		return (unsigned int) ((double) td->o.nr_files
 				* (r / (frand_max + 1.0)));
 	}
@@ -1213,6 +1240,38 @@ static unsigned int __get_next_fileno_rand(struct thread_data *td)
 	return fileno >> FIO_FSERVICE_SHIFT;
 }
 
+/*
+ * At the openfiles limit only the files that are already open can be
+ * used, so pick one of those rather than failing with -EBUSY on each
+ * closed file we come across. Returns -EBUSY if none of them will do.
+ */
+static struct fio_file *get_next_open_file(struct thread_data *td,
+					   unsigned int start,
+					   enum fio_file_flags goodf,
+					   enum fio_file_flags badf)
+{
+	unsigned int i, nr = td->nr_open_files;
+	struct fio_file *f;
+
+	for (i = 0; i < nr; i++) {
+		f = td->files[td->open_file_set[(start + i) % nr]];
+		if (fio_file_done(f))
+			continue;
+		if ((!goodf || (f->flags & goodf)) && !(f->flags & badf)) {
+			dprint(FD_FILE, "get_next_open_file: %p\n", f);
+			return f;
+		}
+	}
+
+	return ERR_PTR(-EBUSY);
+}
+
+static bool open_files_full(struct thread_data *td)
+{
+	return td->open_file_set && td->nr_open_files &&
+		td->nr_open_files >= td->o.open_files;
+}
+
 /*
  * Get next file to service by choosing one at random
  */
@@ -1223,9 +1282,19 @@ static struct fio_file *get_next_file_rand(struct thread_data *td,
 	struct fio_file *f;
 	int fno;
 
+	if (open_files_full(td)) {
+		uint64_t r = __rand(&td->next_file_state);
+
+		return get_next_open_file(td, r % td->nr_open_files, goodf,
+						badf);
+	}
+
 	do {
 		int opened = 0;
 
+		if (td->active_files && !td->nr_active_files)
+			return NULL;
+
 		fno = __get_next_fileno_rand(td);
 
 		f = td->files[fno];
@@ -1259,12 +1328,28 @@ static struct fio_file *get_next_file_rand(struct thread_data *td,
 static struct fio_file *get_next_file_rr(struct thread_data *td, int goodf,
 					 int badf)
 {
-	unsigned int old_next_file = td->next_file;
-	struct fio_file *f;
+	unsigned int nr_tries = td->o.nr_files;
+	struct fio_file *f = NULL;
 
-	do {
+	if (open_files_full(td))
+		return get_next_open_file(td, td->next_open_file++, goodf, badf);
+
+	if (td->done_files_map)
+		nr_tries = td->nr_active_files;
+
+	while (nr_tries--) {
 		int opened = 0;
 
+		if (td->done_files_map &&
+		    axmap_isset(td->done_files_map, td->next_file)) {
+			uint64_t next;
+
+			next = axmap_next_free(td->done_files_map, td->next_file);
+			if (next == -1ULL)
+				break;
+			td->next_file = next;
+		}
+
 		f = td->files[td->next_file];
 
 		td->next_file++;
@@ -1302,7 +1387,7 @@ static struct fio_file *get_next_file_rr(struct thread_data *td, int goodf,
 			td_io_close_file(td, f);
 
 		f = NULL;
-	} while (td->next_file != old_next_file);
+	}
 
 	dprint(FD_FILE, "get_next_file_rr: %p\n", f);
 	return f;
@@ -1379,8 +1464,7 @@ static long set_io_u_file(struct thread_data *td, struct io_u *io_u)
 		if (td->o.file_service_type & __FIO_FSERVICE_NONUNIFORM)
 			fio_file_reset(td, f);
 		else {
-			fio_file_set_done(f);
-			td->nr_done_files++;
+			fio_file_mark_done(td, f);
 			dprint(FD_FILE, "%s: is done (%d of %d)\n", f->file_name,
 					td->nr_done_files, td->o.nr_files);
 		}
@@ -2173,23 +2257,29 @@ void io_u_queued(struct thread_data *td, struct io_u *io_u)
 }
 
 /*
- * See if we should reuse the last seed, if dedupe is enabled
+ * See if we should reuse the last seed, if dedupe is enabled. 'dedupe' is
+ * set if the returned state regenerates an earlier buffer.
  */
-static struct frand_state *get_buf_state(struct thread_data *td)
+static struct frand_state *get_buf_state(struct thread_data *td, bool *dedupe)
 {
 	unsigned int v;
 	unsigned long long i;
 
+	*dedupe = false;
+
 	if (!td->o.dedupe_percentage)
 		return &td->buf_state;
 	else if (td->o.dedupe_percentage == 100) {
 		frand_copy(&td->buf_state_prev, &td->buf_state);
+		*dedupe = true;
 		return &td->buf_state;
 	}
 
 	v = rand_between(&td->dedupe_state, 1, 100);
 
-	if (v <= td->o.dedupe_percentage)
+	if (v <= td->o.dedupe_percentage) {
+		*dedupe = true;
+
 		switch (td->o.dedupe_mode) {
 		case DEDUPE_MODE_REPEAT:
 			/*
@@ -2208,10 +2298,49 @@ static struct frand_state *get_buf_state(struct thread_data *td)
 			log_err("unexpected dedupe mode %u\n", td->o.dedupe_mode);
 			assert(0);
 		}
+	}
 
 	return &td->buf_state;
 }
 
+/*
+ * Turn an exact copy of an earlier buffer into a shifted or similar one.
+ * Randomness comes from the dedupe state, so the sequence of unique
+ * buffers (and the dedupe working set) is not affected.
+ */
+static void dedupe_variant_buf(struct thread_data *td, void *buf,
+			       unsigned long long len)
+{
+	unsigned long long nsect = len >> 9, shift;
+	unsigned int i;
+	uint64_t seed;
+
+	switch (td->o.dedupe_variant) {
+	case DEDUPE_VARIANT_SHIFTED:
+		/*
+		 * Move the contents up by 1..nsect-1 sectors and fill the gap
+		 * at the front with unique data.
+		 */
+		if (nsect < 2)
+			return;
+		shift = rand_between(&td->dedupe_state, 1, nsect - 1) << 9;
+		memmove(buf + shift, buf, len - shift);
+		seed = __get_next_seed(&td->dedupe_state);
+		__fill_random_buf(buf, shift, seed);
+		break;
+	case DEDUPE_VARIANT_SIMILAR:
+		for (i = 0; i < td->o.dedupe_similar_bits; i++) {
+			unsigned long long bit;
+
+			bit = rand_between(&td->dedupe_state, 0, len * 8 - 1);
+			((uint8_t *) buf)[bit >> 3] ^= 1U << (bit & 7);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
 static void save_buf_state(struct thread_data *td, struct frand_state *rs)
 {
 	if (td->o.dedupe_percentage == 100)
@@ -2228,11 +2357,14 @@ void fill_io_buffer(struct thread_data *td, void *buf, unsigned long long min_wr
 	if (o->mem_type == MEM_CUDA_MALLOC)
 		return;
 
-	if (o->compress_percentage || o->dedupe_percentage) {
+	if (o->compress_percentage || o->dedupe_percentage ||
+	    td->compress_pool.buf) {
 		unsigned int perc = td->o.compress_percentage;
 		struct frand_state *rs = NULL;
 		unsigned long long left = max_bs;
 		unsigned long long this_write;
+		void *start = buf;
+		bool dedupe = false;
 
 		do {
 			/*
@@ -2243,28 +2375,38 @@ void fill_io_buffer(struct thread_data *td, void *buf, unsigned long long min_wr
 			 * as well.
 			 */
 			if (!rs)
-				rs = get_buf_state(td);
+				rs = get_buf_state(td, &dedupe);
 
 			min_write = min(min_write, left);
 
 			this_write = min_not_zero(min_write,
 						(unsigned long long) td->o.compress_chunk);
 
-			fill_random_buf_percentage(rs, buf, perc,
-				this_write, this_write,
-				o->buffer_pattern,
-				o->buffer_pattern_bytes);
+			if (td->compress_pool.buf)
+				compress_pool_fill(&td->compress_pool, buf,
+					this_write, __get_next_seed(rs));
+			else
+				fill_random_buf_percentage(rs, buf, perc,
+					this_write, this_write,
+					o->buffer_pattern,
+					o->buffer_pattern_bytes);
 
 			buf += this_write;
 			left -= this_write;
 			save_buf_state(td, rs);
 		} while (left);
+
+		if (dedupe && o->dedupe_variant != DEDUPE_VARIANT_EXACT)
+			dedupe_variant_buf(td, start, max_bs);
 	} else if (o->buffer_pattern_bytes)
 		fill_buffer_pattern(td, buf, max_bs);
 	else if (o->zero_buffers)
 		memset(buf, 0, max_bs);
-	else
-		fill_random_buf(get_buf_state(td), buf, max_bs);
+	else {
+		bool dedupe;
+
+		fill_random_buf(get_buf_state(td, &dedupe), buf, max_bs);
+	}
 }
 
 /*
@@ -526,7 +526,7 @@ int td_io_open_file(struct thread_data *td, struct fio_file *f)
 	fio_file_clear_closing(f);
 	disk_util_inc(f->du);
 
-	td->nr_open_files++;
+	fio_file_add_open(td, f);
 	get_file(f);
 
 	if (f->filetype == FIO_TYPE_PIPE) {
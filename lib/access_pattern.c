@@ -0,0 +1,466 @@
+/*
+ * Composable, time varying offset distributions.
+ *
+ * A pattern is a '+' separated list of terms:
+ *
+ *	[weight%]kind[:arg][/mod=value]...
+ *
+ * where kind is one of uniform, zipf, pareto, normal or scan, and the
+ * modifiers place the term in a window of the file and make it move:
+ *
+ *	size=N%		window size, default 100%
+ *	start=N%	window start, default 0%
+ *	drift=T		slide the window over the whole file once every T
+ *	grow=T		grow the window linearly to the full file over T
+ *	every=T		only run the term for the first 'for' of every T
+ *	for=T
+ *
+ * Terms without a weight share what is left of 100%. Skewed terms are
+ * hottest at the start of their window. The pattern is compiled once into
+ * quantile tables, each I/O then costs a couple of random numbers and a
+ * table lookup. Time dependent state is only rebuilt once per msec.
+ */
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "access_pattern.h"
+
+#define APAT_DEF_ZIPF	1.1
+#define APAT_DEF_PARETO	0.2
+#define APAT_DEF_NORMAL	10.0
+
+static const struct {
+	const char *name;
+	unsigned int type;
+	double def;
+} apat_kinds[] = {
+	{ "uniform",	APAT_UNIFORM,	0.0 },
+	{ "zipf",	APAT_ZIPF,	APAT_DEF_ZIPF },
+	{ "pareto",	APAT_PARETO,	APAT_DEF_PARETO },
+	{ "normal",	APAT_NORMAL,	APAT_DEF_NORMAL },
+	{ "scan",	APAT_SCAN,	0.0 },
+};
+
+static const char *skip_blank(const char *p)
+{
+	while (isspace((unsigned char) *p))
+		p++;
+	return p;
+}
+
+static bool parse_double(const char **p, double *val)
+{
+	char *end;
+
+	*val = strtod(*p, &end);
+	if (end == *p)
+		return false;
+	*p = end;
+	return true;
+}
+
+static bool parse_percent(const char **p, double *val)
+{
+	if (!parse_double(p, val))
+		return false;
+	if (**p == '%')
+		(*p)++;
+	if (*val < 0.0 || *val > 100.0)
+		return false;
+	*val /= 100.0;
+	return true;
+}
+
+/*
+ * Time with an optional ms, s, m or h suffix, seconds if none given
+ */
+static bool parse_msec(const char **p, uint64_t *msec)
+{
+	double val, mult = 1000.0;
+
+	if (!parse_double(p, &val) || val <= 0.0)
+		return false;
+
+	if (!strncmp(*p, "ms", 2)) {
+		mult = 1.0;
+		*p += 2;
+	} else if (**p == 's') {
+		(*p)++;
+	} else if (**p == 'm') {
+		mult = 60 * 1000.0;
+		(*p)++;
+	} else if (**p == 'h') {
+		mult = 3600 * 1000.0;
+		(*p)++;
+	}
+
+	*msec = val * mult;
+	return *msec != 0;
+}
+
+static const char *parse_term(const char **pp, struct apat_term *t)
+{
+	const char *p = skip_blank(*pp);
+	unsigned int i, len;
+
+	t->weight = -1.0;
+	t->start = 0.0;
+	t->size = 1.0;
+
+	if (isdigit((unsigned char) *p) || *p == '.') {
+		if (!parse_double(&p, &t->weight) || *p != '%')
+			return "bad term weight";
+		if (t->weight <= 0.0 || t->weight > 100.0)
+			return "term weight out of range";
+		t->weight /= 100.0;
+		p++;
+	}
+
+	p = skip_blank(p);
+	for (len = 0; isalpha((unsigned char) p[len]); len++)
+		;
+
+	for (i = 0; i < sizeof(apat_kinds) / sizeof(apat_kinds[0]); i++) {
+		if (strlen(apat_kinds[i].name) == len &&
+		    !strncmp(p, apat_kinds[i].name, len))
+			break;
+	}
+	if (i == sizeof(apat_kinds) / sizeof(apat_kinds[0]))
+		return "unknown term kind";
+
+	t->type = apat_kinds[i].type;
+	t->arg = apat_kinds[i].def;
+	p += len;
+
+	if (*p == ':') {
+		p++;
+		if (t->type == APAT_UNIFORM || t->type == APAT_SCAN)
+			return "uniform and scan take no argument";
+		if (!parse_double(&p, &t->arg))
+			return "bad term argument";
+	}
+
+	if (t->type == APAT_ZIPF && t->arg <= 0.0)
+		return "zipf theta must be positive";
+	if (t->type == APAT_PARETO && (t->arg <= 0.0 || t->arg >= 1.0))
+		return "pareto input out of range (0 < input < 1.0)";
+	if (t->type == APAT_NORMAL && (t->arg <= 0.0 || t->arg > 100.0))
+		return "normal deviation out of range (0 < input <= 100.0)";
+
+	p = skip_blank(p);
+	while (*p == '/') {
+		const char *key = skip_blank(p + 1);
+		bool ok;
+
+		for (len = 0; isalpha((unsigned char) key[len]); len++)
+			;
+		p = skip_blank(key + len);
+		if (*p != '=')
+			return "modifier needs a value";
+		p = skip_blank(p + 1);
+
+		if (len == 4 && !strncmp(key, "size", 4))
+			ok = parse_percent(&p, &t->size) && t->size > 0.0;
+		else if (len == 5 && !strncmp(key, "start", 5))
+			ok = parse_percent(&p, &t->start) && t->start < 1.0;
+		else if (len == 5 && !strncmp(key, "drift", 5))
+			ok = parse_msec(&p, &t->drift_msec);
+		else if (len == 4 && !strncmp(key, "grow", 4))
+			ok = parse_msec(&p, &t->grow_msec);
+		else if (len == 5 && !strncmp(key, "every", 5))
+			ok = parse_msec(&p, &t->every_msec);
+		else if (len == 3 && !strncmp(key, "for", 3))
+			ok = parse_msec(&p, &t->for_msec);
+		else
+			return "unknown modifier";
+
+		if (!ok)
+			return "bad modifier value";
+		p = skip_blank(p);
+	}
+
+	if (!t->every_msec != !t->for_msec)
+		return "every= and for= must be given together";
+	if (t->every_msec && t->for_msec >= t->every_msec)
+		return "for= must be shorter than every=";
+
+	*pp = p;
+	return NULL;
+}
+
+struct access_pattern *apat_parse(const char *spec, const char **err)
+{
+	struct access_pattern *ap;
+	unsigned int i, nr_unweighted = 0;
+	double total = 0.0;
+	const char *p = spec;
+
+	ap = calloc(1, sizeof(*ap));
+	if (!ap) {
+		*err = "out of memory";
+		return NULL;
+	}
+
+	do {
+		struct apat_term *t;
+
+		if (ap->nr_terms == APAT_MAX_TERMS) {
+			*err = "too many terms";
+			goto err;
+		}
+
+		t = &ap->terms[ap->nr_terms++];
+		*err = parse_term(&p, t);
+		if (*err)
+			goto err;
+
+		if (t->weight < 0.0)
+			nr_unweighted++;
+		else
+			total += t->weight;
+		if (t->drift_msec || t->grow_msec || t->every_msec)
+			ap->timed = true;
+	} while (*p++ == '+');
+
+	if (*--p != '\0') {
+		*err = "trailing garbage";
+		goto err;
+	}
+
+	if (total > 1.0 + 1e-9) {
+		*err = "term weights exceed 100%";
+		goto err;
+	}
+	if (!nr_unweighted && total < 1.0 - 1e-9) {
+		*err = "term weights must add up to 100%";
+		goto err;
+	}
+	if (nr_unweighted && total >= 1.0 - 1e-9) {
+		*err = "no weight left for unweighted terms";
+		goto err;
+	}
+
+	for (i = 0; i < ap->nr_terms; i++) {
+		if (ap->terms[i].weight < 0.0)
+			ap->terms[i].weight = (1.0 - total) / nr_unweighted;
+	}
+
+	return ap;
+err:
+	free(ap);
+	return NULL;
+}
+
+static double normal_cdf(double x, double sigma)
+{
+	return 0.5 * erfc(-(x - 0.5) / (sigma * M_SQRT2));
+}
+
+/*
+ * Normal around the middle of the window, truncated to the window
+ */
+static double normal_quantile(double u, double sigma)
+{
+	double lo = normal_cdf(0.0, sigma), hi = normal_cdf(1.0, sigma);
+	double target = lo + u * (hi - lo);
+	double a = 0.0, b = 1.0;
+	int i;
+
+	for (i = 0; i < 52; i++) {
+		double mid = (a + b) / 2.0;
+
+		if (normal_cdf(mid, sigma) < target)
+			a = mid;
+		else
+			b = mid;
+	}
+
+	return (a + b) / 2.0;
+}
+
+/*
+ * Inverse CDF of the term over its window, as a fraction of the window.
+ * Zipf uses the continuous approximation over 'n' ranks.
+ */
+static double term_quantile(const struct apat_term *t, double u, double n)
+{
+	double e;
+
+	switch (t->type) {
+	case APAT_ZIPF:
+		if (t->arg == 1.0)
+			return (pow(1.0 + n, u) - 1.0) / n;
+		e = 1.0 - t->arg;
+		return (pow(u * (pow(1.0 + n, e) - 1.0) + 1.0, 1.0 / e) - 1.0) / n;
+	case APAT_PARETO:
+		return pow(u, log(t->arg) / log(1.0 - t->arg));
+	case APAT_NORMAL:
+		return normal_quantile(u, t->arg / 100.0);
+	default:
+		return u;
+	}
+}
+
+/*
+ * Build the sampling tables. 'nranges' is the number of blocks in the
+ * largest file, skew is resolved at block granularity of the starting
+ * window of each term.
+ */
+bool apat_compile(struct access_pattern *ap, uint64_t nranges)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < ap->nr_terms; i++) {
+		struct apat_term *t = &ap->terms[i];
+		double n;
+
+		if (t->type == APAT_UNIFORM || t->type == APAT_SCAN || t->qtab)
+			continue;
+
+		t->qtab = malloc((APAT_QUANTILES + 1) * sizeof(double));
+		if (!t->qtab)
+			return false;
+
+		n = t->size * nranges;
+		if (n < 1.0)
+			n = 1.0;
+
+		t->qtab[0] = 0.0;
+		for (j = 1; j < APAT_QUANTILES; j++) {
+			double x = term_quantile(t, (double) j / APAT_QUANTILES, n);
+
+			if (x < t->qtab[j - 1])
+				x = t->qtab[j - 1];
+			t->qtab[j] = x > 1.0 ? 1.0 : x;
+		}
+		t->qtab[APAT_QUANTILES] = 1.0;
+	}
+
+	return true;
+}
+
+void apat_free(struct access_pattern *ap)
+{
+	unsigned int i;
+
+	if (!ap)
+		return;
+
+	for (i = 0; i < ap->nr_terms; i++)
+		free(ap->terms[i].qtab);
+	free(ap);
+}
+
+void apat_state_init(struct apat_state *s, unsigned int seed)
+{
+	memset(s, 0, sizeof(*s));
+	init_rand_seed(&s->rand, seed, true);
+}
+
+static void apat_build_frame(const struct access_pattern *ap,
+			     struct apat_state *s, uint64_t msec)
+{
+	double w[APAT_MAX_TERMS], total = 0.0, cum = 0.0;
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < ap->nr_terms; i++) {
+		const struct apat_term *t = &ap->terms[i];
+		double start = t->start, size = t->size;
+
+		if (t->every_msec) {
+			uint64_t period = msec / t->every_msec;
+
+			if (period != s->period[i]) {
+				s->period[i] = period;
+				s->cursor[i] = 0;
+			}
+			if (msec % t->every_msec >= t->for_msec)
+				continue;
+		}
+		if (t->drift_msec) {
+			start += (double) (msec % t->drift_msec) / t->drift_msec;
+			if (start >= 1.0)
+				start -= 1.0;
+		}
+		if (t->grow_msec) {
+			if (msec >= t->grow_msec)
+				size = 1.0;
+			else
+				size += (1.0 - size) * msec / t->grow_msec;
+		}
+
+		s->active[nr].term = i;
+		s->active[nr].start = start;
+		s->active[nr].size = size;
+		w[nr++] = t->weight;
+		total += t->weight;
+	}
+
+	for (i = 0; i < nr; i++) {
+		cum += w[i];
+		s->active[i].thresh = (cum / total) * FRAND32_MAX;
+	}
+	if (nr)
+		s->active[nr - 1].thresh = FRAND32_MAX;
+
+	s->nr_active = nr;
+	s->frame_msec = msec;
+	s->frame_valid = true;
+}
+
+/*
+ * Return the next block in 0 .. nranges - 1
+ */
+uint64_t apat_next(const struct access_pattern *ap, struct apat_state *s,
+		   uint64_t msec, uint64_t nranges)
+{
+	const struct apat_term *t;
+	uint64_t r, wstart, wblocks, off;
+	uint32_t sel;
+	unsigned int i;
+	double pos;
+
+	if (!s->frame_valid || (ap->timed && msec != s->frame_msec))
+		apat_build_frame(ap, s, msec);
+
+	r = __rand(&s->rand);
+	if (!s->nr_active)
+		return (r >> 11) * (1.0 / (1ULL << 53)) * nranges;
+
+	sel = r >> 32;
+	for (i = 0; i < s->nr_active - 1; i++)
+		if (sel <= s->active[i].thresh)
+			break;
+
+	t = &ap->terms[s->active[i].term];
+	wstart = s->active[i].start * nranges;
+	if (wstart >= nranges)
+		wstart = 0;
+	wblocks = s->active[i].size * nranges;
+	if (!wblocks)
+		wblocks = 1;
+
+	if (t->type == APAT_SCAN)
+		off = s->cursor[s->active[i].term]++ % wblocks;
+	else {
+		r = __rand(&s->rand);
+		if (t->qtab) {
+			const double *q = &t->qtab[r >> 52];
+			double frac = (r & ((1ULL << 52) - 1)) *
+					(1.0 / (1ULL << 52));
+
+			pos = q[0] + frac * (q[1] - q[0]);
+		} else
+			pos = (r >> 11) * (1.0 / (1ULL << 53));
+
+		off = pos * wblocks;
+		if (off >= wblocks)
+			off = wblocks - 1;
+	}
+
+	off += wstart;
+	if (off >= nranges)
+		off -= nranges;
+	return off;
+}
@@ -0,0 +1,74 @@
+#ifndef FIO_ACCESS_PATTERN_H
+#define FIO_ACCESS_PATTERN_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include "rand.h"
+
+#define APAT_MAX_TERMS	16
+#define APAT_QUANTILES	4096
+
+enum {
+	APAT_UNIFORM = 0,
+	APAT_ZIPF,
+	APAT_PARETO,
+	APAT_NORMAL,
+	APAT_SCAN,
+};
+
+/*
+ * One term of an access pattern. 'start' and 'size' are fractions of the
+ * file, the times are in msec and 0 when unused. Skewed terms get a table
+ * of APAT_QUANTILES equal probability slices of their window, so sampling
+ * is a table lookup plus a uniform pick inside the slice.
+ */
+struct apat_term {
+	unsigned int type;
+	double arg;
+	double weight;
+	double start;
+	double size;
+	uint64_t drift_msec;
+	uint64_t grow_msec;
+	uint64_t every_msec;
+	uint64_t for_msec;
+	double *qtab;
+};
+
+/*
+ * A parsed and compiled pattern. It is read-only once compiled and can be
+ * shared by all files of a job.
+ */
+struct access_pattern {
+	unsigned int nr_terms;
+	bool timed;
+	struct apat_term terms[APAT_MAX_TERMS];
+};
+
+/*
+ * Per file sampling state. The frame holds the term windows and selection
+ * thresholds for the current msec, it is only rebuilt when time moves on.
+ */
+struct apat_state {
+	struct frand_state rand;
+	uint64_t frame_msec;
+	bool frame_valid;
+	unsigned int nr_active;
+	struct {
+		unsigned int term;
+		uint32_t thresh;
+		double start;
+		double size;
+	} active[APAT_MAX_TERMS];
+	uint64_t cursor[APAT_MAX_TERMS];
+	uint64_t period[APAT_MAX_TERMS];
+};
+
+struct access_pattern *apat_parse(const char *spec, const char **err);
+bool apat_compile(struct access_pattern *ap, uint64_t nranges);
+void apat_free(struct access_pattern *ap);
+void apat_state_init(struct apat_state *s, unsigned int seed);
+uint64_t apat_next(const struct access_pattern *ap, struct apat_state *s,
+		   uint64_t msec, uint64_t nranges);
+
+#endif
@@ -22,6 +22,7 @@
 
 #include "../arch/arch.h"
 #include "axmap.h"
+#include "memalign.h"
 #include "../minmax.h"
 
 #if BITS_PER_LONG == 64
@@ -76,11 +77,15 @@ struct axmap_level {
  * @levels: struct axmap_level array in which lower levels contain more bits
  *	than higher levels.
  * @nr_bits: One more than the highest value stored in the set.
+ * @shared: Set if bits may be set concurrently, see axmap_new_shared().
+ * @free_mem: Releases the memory backing the map.
  */
 struct axmap {
 	unsigned int nr_levels;
 	struct axmap_level *levels;
 	uint64_t nr_bits;
+	bool shared;
+	free_fn free_mem;
 };
 
 /* Remove all elements from the @axmap set */
@@ -97,25 +102,27 @@ void axmap_reset(struct axmap *axmap)
 
 void axmap_free(struct axmap *axmap)
 {
+	free_fn free_mem;
 	unsigned int i;
 
 	if (!axmap)
 		return;
 
+	free_mem = axmap->free_mem;
 	for (i = 0; i < axmap->nr_levels; i++)
-		free(axmap->levels[i].map);
+		free_mem(axmap->levels[i].map);
 
-	free(axmap->levels);
-	free(axmap);
+	free_mem(axmap->levels);
+	free_mem(axmap);
 }
 
-/* Allocate memory for a set that can store the numbers 0 .. @nr_bits - 1. */
-struct axmap *axmap_new(uint64_t nr_bits)
+static struct axmap *__axmap_new(uint64_t nr_bits, bool shared,
+				 malloc_fn alloc_mem, free_fn free_mem)
 {
 	struct axmap *axmap;
 	unsigned int i, levels;
 
-	axmap = malloc(sizeof(*axmap));
+	axmap = alloc_mem(sizeof(*axmap));
 	if (!axmap)
 		return NULL;
 
@@ -127,10 +134,13 @@ struct axmap *axmap_new(uint64_t nr_bits)
 	}
 
 	axmap->nr_levels = levels;
-	axmap->levels = calloc(axmap->nr_levels, sizeof(struct axmap_level));
+	axmap->levels = alloc_mem(axmap->nr_levels * sizeof(struct axmap_level));
 	if (!axmap->levels)
 		goto free_axmap;
+	memset(axmap->levels, 0, axmap->nr_levels * sizeof(struct axmap_level));
 	axmap->nr_bits = nr_bits;
+	axmap->shared = shared;
+	axmap->free_mem = free_mem;
 
 	for (i = 0; i < axmap->nr_levels; i++) {
 		struct axmap_level *al = &axmap->levels[i];
@@ -139,7 +149,7 @@ struct axmap *axmap_new(uint64_t nr_bits)
 
 		al->level = i;
 		al->map_size = nr_bits;
-		al->map = malloc(al->map_size * sizeof(unsigned long));
+		al->map = alloc_mem(al->map_size * sizeof(unsigned long));
 		if (!al->map)
 			goto free_levels;
 
@@ -150,42 +160,32 @@ struct axmap *axmap_new(uint64_t nr_bits)
 
 free_levels:
 	for (i = 0; i < axmap->nr_levels; i++)
-		free(axmap->levels[i].map);
+		if (axmap->levels[i].map)
+			free_mem(axmap->levels[i].map);
 
-	free(axmap->levels);
+	free_mem(axmap->levels);
 
 free_axmap:
-	free(axmap);
+	free_mem(axmap);
 	return NULL;
 }
 
+/* Allocate memory for a set that can store the numbers 0 .. @nr_bits - 1. */
+struct axmap *axmap_new(uint64_t nr_bits)
+{
+	return __axmap_new(nr_bits, false, malloc, free);
+}
+
 /*
- * Call @func for each level, starting at level zero, until a level is found
- * for which @func returns true. Return false if none of the @func calls
- * returns true.
+ * Like axmap_new(), but the map may be updated concurrently by several
+ * threads or processes. @alloc_mem must return memory visible to all of
+ * them. Bits are claimed with atomic updates, so every bit is handed out by
+ * axmap_set_nr() exactly once.
  */
-static bool axmap_handler(struct axmap *axmap, uint64_t bit_nr,
-			  bool (*func)(struct axmap_level *, uint64_t, unsigned int,
-			  void *), void *data)
+struct axmap *axmap_new_shared(uint64_t nr_bits, malloc_fn alloc_mem,
+			       free_fn free_mem)
 {
-	struct axmap_level *al;
-	uint64_t index = bit_nr;
-	int i;
-
-	for (i = 0; i < axmap->nr_levels; i++) {
-		unsigned long offset = index >> UNIT_SHIFT;
-		unsigned int bit = index & BLOCKS_PER_UNIT_MASK;
-
-		al = &axmap->levels[i];
-
-		if (func(al, offset, bit, data))
-			return true;
-
-		if (index)
-			index >>= UNIT_SHIFT;
-	}
-
-	return false;
+	return __axmap_new(nr_bits, true, alloc_mem, free_mem);
 }
 
 /*
@@ -210,84 +210,113 @@ static bool axmap_handler_topdown(struct axmap *axmap, uint64_t bit_nr,
 	return false;
 }
 
-struct axmap_set_data {
-	unsigned int nr_bits;
-	unsigned int set_bits;
-};
-
 /*
- * Set at most @__data->nr_bits bits in @al at offset @offset. Do not exceed
- * the boundary of the element at offset @offset. Return the number of bits
- * that have been set in @__data->set_bits if @al->level == 0.
+ * Trim @mask, a contiguous run of bits starting at @bit, so that it ends
+ * before the first bit already set in @word. Returns the number of bits
+ * left in the run.
  */
-static bool axmap_set_fn(struct axmap_level *al, uint64_t offset,
-			 unsigned int bit, void *__data)
+static unsigned int trim_to_free(unsigned long word, unsigned int bit,
+				 unsigned int nr_bits, unsigned long *mask)
 {
-	struct axmap_set_data *data = __data;
-	unsigned long mask, overlap;
-	unsigned int nr_bits;
-
-	nr_bits = min(data->nr_bits, BLOCKS_PER_UNIT - bit);
-
-	mask = bit_masks[nr_bits] << bit;
-
-	/*
-	 * Mask off any potential overlap, only sets contig regions
-	 */
-	overlap = al->map[offset] & mask;
-	if (overlap == mask) {
-		data->set_bits = 0;
-		return true;
-	}
+	unsigned long overlap = word & *mask;
 
 	if (overlap) {
 		nr_bits = ffz(~overlap) - bit;
-		if (!nr_bits)
-			return true;
-		mask = bit_masks[nr_bits] << bit;
+		*mask = bit_masks[nr_bits] << bit;
 	}
 
-	assert(mask);
-	assert(!(al->map[offset] & mask));
-	al->map[offset] |= mask;
+	return nr_bits;
+}
 
-	if (!al->level)
-		data->set_bits = nr_bits;
+/*
+ * Set up to @nr_bits bits starting at @bit in word @offset of level zero,
+ * stopping at the first bit that is already set. Returns the number of bits
+ * set, and whether that made the word full.
+ */
+static unsigned int axmap_set_word(struct axmap *axmap, uint64_t offset,
+				   unsigned int bit, unsigned int nr_bits,
+				   bool *full)
+{
+	unsigned long *word = &axmap->levels[0].map[offset];
+	unsigned long old, new, mask;
 
-	/* For the next level */
-	data->nr_bits = 1;
+	if (!axmap->shared) {
+		old = *word;
+		mask = bit_masks[nr_bits] << bit;
+		nr_bits = trim_to_free(old, bit, nr_bits, &mask);
+		new = old | mask;
+		*word = new;
+	} else {
+		old = atomic_load_relaxed(word);
+		do {
+			mask = bit_masks[nr_bits] << bit;
+			nr_bits = trim_to_free(old, bit, nr_bits, &mask);
+			if (!nr_bits)
+				break;
+			new = old | mask;
+		} while (!atomic_compare_exchange_weak(
+				(_Atomic unsigned long *) word, &old, new));
+		if (!nr_bits)
+			new = old;
+	}
 
-	return al->map[offset] != -1UL;
+	*full = nr_bits && new == -1UL;
+	return nr_bits;
 }
 
 /*
- * Set up to @data->nr_bits starting from @bit_nr in @axmap. Start at
- * @bit_nr. If that bit has not yet been set then set it and continue until
- * either @data->nr_bits have been set or a 1 bit is found. Store the number
- * of bits that have been set in @data->set_bits. It is guaranteed that all
- * bits that have been requested to set fit in the same unsigned long word of
- * level 0 of @axmap.
+ * Set @mask in a word of a level above zero. These bits are always clear
+ * beforehand: only the caller that filled the word below gets to set them.
+ * Returns whether the word is now full.
  */
-static void __axmap_set(struct axmap *axmap, uint64_t bit_nr,
-			 struct axmap_set_data *data)
+static bool axmap_or_word(struct axmap *axmap, struct axmap_level *al,
+			  uint64_t offset, unsigned long mask)
 {
-	unsigned int nr_bits = data->nr_bits;
+	unsigned long *word = &al->map[offset];
 
-	if (bit_nr > axmap->nr_bits)
-		return;
-	else if (bit_nr + nr_bits > axmap->nr_bits)
-		nr_bits = axmap->nr_bits - bit_nr;
-
-	assert(nr_bits <= BLOCKS_PER_UNIT);
+	if (axmap->shared)
+		return (atomic_fetch_or((_Atomic unsigned long *) word, mask) |
+			mask) == -1UL;
 
-	axmap_handler(axmap, bit_nr, axmap_set_fn, data);
+	assert(!(*word & mask));
+	*word |= mask;
+	return *word == -1UL;
 }
 
-void axmap_set(struct axmap *axmap, uint64_t bit_nr)
+/*
+ * Words @index .. @index + @nr - 1 at level @level - 1 just became full,
+ * so set their bits at @level and continue upwards for any words that
+ * fill up as a result. Full words always form one contiguous range.
+ */
+static void axmap_set_upper(struct axmap *axmap, unsigned int level,
+			    uint64_t index, uint64_t nr)
 {
-	struct axmap_set_data data = { .nr_bits = 1, };
+	for (; level < axmap->nr_levels; level++) {
+		struct axmap_level *al = &axmap->levels[level];
+		uint64_t end = index + nr, first_full = -1ULL, last_full = 0;
+
+		while (index < end) {
+			uint64_t offset = index >> UNIT_SHIFT;
+			unsigned int bit = index & BLOCKS_PER_UNIT_MASK;
+			unsigned int this_nr;
+
+			this_nr = min(end - index,
+				      (uint64_t) (BLOCKS_PER_UNIT - bit));
+			if (axmap_or_word(axmap, al, offset,
+					  bit_masks[this_nr] << bit)) {
+				if (first_full == -1ULL)
+					first_full = offset;
+				last_full = offset;
+			}
+			index += this_nr;
+		}
 
-	__axmap_set(axmap, bit_nr, &data);
+		if (first_full == -1ULL)
+			break;
+
+		index = first_full;
+		nr = last_full - first_full + 1;
+	}
 }
 
 /*
@@ -295,33 +324,53 @@ void axmap_set(struct axmap *axmap, uint64_t bit_nr)
  * bit has not yet been set then set it and continue until either @nr_bits
  * have been set or a 1 bit is found. Return the number of bits that have been
  * set.
+ *
+ * Level zero is updated a word at a time, and the words that became full
+ * are then marked in one pass per upper level, rather than walking all
+ * levels for each word.
  */
 unsigned int axmap_set_nr(struct axmap *axmap, uint64_t bit_nr,
 			  unsigned int nr_bits)
 {
+	uint64_t first_full = -1ULL, last_full = 0;
 	unsigned int set_bits = 0;
 
-	do {
-		struct axmap_set_data data = { .nr_bits = nr_bits, };
-		unsigned int max_bits, this_set;
+	if (bit_nr >= axmap->nr_bits)
+		return 0;
+	if (nr_bits > axmap->nr_bits - bit_nr)
+		nr_bits = axmap->nr_bits - bit_nr;
 
-		max_bits = BLOCKS_PER_UNIT - (bit_nr & BLOCKS_PER_UNIT_MASK);
-		if (nr_bits > max_bits)
-			data.nr_bits = max_bits;
+	while (set_bits < nr_bits) {
+		uint64_t offset = bit_nr >> UNIT_SHIFT;
+		unsigned int bit = bit_nr & BLOCKS_PER_UNIT_MASK;
+		unsigned int this_nr, this_set;
+		bool full;
+
+		this_nr = min(nr_bits - set_bits, BLOCKS_PER_UNIT - bit);
+		this_set = axmap_set_word(axmap, offset, bit, this_nr, &full);
+		if (full) {
+			if (first_full == -1ULL)
+				first_full = offset;
+			last_full = offset;
+		}
 
-		this_set = data.nr_bits;
-		__axmap_set(axmap, bit_nr, &data);
-		set_bits += data.set_bits;
-		if (data.set_bits != this_set)
+		set_bits += this_set;
+		bit_nr += this_set;
+		if (this_set != this_nr)
 			break;
+	}
 
-		nr_bits -= data.set_bits;
-		bit_nr += data.set_bits;
-	} while (nr_bits);
+	if (first_full != -1ULL)
+		axmap_set_upper(axmap, 1, first_full, last_full - first_full + 1);
 
 	return set_bits;
 }
 
+void axmap_set(struct axmap *axmap, uint64_t bit_nr)
+{
+	axmap_set_nr(axmap, bit_nr, 1);
+}
+
 static bool axmap_isset_fn(struct axmap_level *al, uint64_t offset,
 			   unsigned int bit, void *unused)
 {
@@ -336,6 +385,30 @@ bool axmap_isset(struct axmap *axmap, uint64_t bit_nr)
 	return false;
 }
 
+/*
+ * Return the offset of the first word at or after @offset in @al that has
+ * a clear bit, or @al->map_size if there is none. Four words are checked
+ * per step, which the compiler can turn into vector compares.
+ */
+static uint64_t find_nonfull_word(const struct axmap_level *al,
+				  uint64_t offset)
+{
+	const unsigned long *map = al->map;
+
+	for (; offset + 4 <= al->map_size; offset += 4) {
+		if ((map[offset] & map[offset + 1] & map[offset + 2] &
+		     map[offset + 3]) != -1UL)
+			break;
+	}
+
+	for (; offset < al->map_size; offset++) {
+		if (map[offset] != -1UL)
+			break;
+	}
+
+	return offset;
+}
+
 /*
  * Find the first free bit that is at least as large as bit_nr.  Return
  * -1 if no free bit is found before the end of the map.
@@ -382,13 +455,13 @@ static uint64_t axmap_find_first_free(struct axmap *axmap, uint64_t bit_nr)
 			goto found;
 
 		/*
-		 * No free bit in the first word, so iterate
-		 * looking for a word with one or more free bits.
+		 * No free bit in the first word, so look for a word
+		 * with one or more free bits.
 		 */
-		for (offset++; offset < al->map_size; offset++) {
+		offset = find_nonfull_word(al, offset + 1);
+		if (offset < al->map_size) {
 			temp = ~al->map[offset];
-			if (temp)
-				goto found;
+			goto found;
 		}
 
 		/* Did not find a free bit */
@@ -3,9 +3,12 @@
 
 #include <inttypes.h>
 #include "types.h"
+#include "memalign.h"
 
 struct axmap;
 struct axmap *axmap_new(uint64_t nr_bits);
+struct axmap *axmap_new_shared(uint64_t nr_bits, malloc_fn alloc_mem,
+			       free_fn free_mem);
 void axmap_free(struct axmap *bm);
 
 void axmap_set(struct axmap *axmap, uint64_t bit_nr);
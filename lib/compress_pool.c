@@ -0,0 +1,194 @@
+/*
+ * Generate data that compresses to roughly a given ratio in the way real
+ * data does, instead of random data followed by zeroes.
+ *
+ * Compressors get their savings from two places: LZ matches, where a
+ * string repeats something seen shortly before, and entropy coding of the
+ * literals that are left (zstd, zlib, but not lz4). COMPRESS_MODE_LZ gets
+ * all of the savings from matches, so it applies to both kinds of
+ * compressor. COMPRESS_MODE_ENTROPY gets half of the savings from matches
+ * and the rest by drawing literals from a reduced alphabet.
+ *
+ * Doing this per IO is too expensive, so the data is generated once into a
+ * pool. IO buffers are copied out of it at a seed dependent offset, with a
+ * seed dependent byte substitution applied so that buffers don't repeat.
+ * The substitution maps every byte through the same bijection, so both the
+ * matches and the symbol entropy survive it.
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "compress_pool.h"
+#include "rand.h"
+#include "../hash.h"
+#include "../minmax.h"
+
+#define CP_MIN_MATCH	16
+#define CP_MAX_MATCH	128
+#define CP_MIN_DIST	8
+#define CP_MAX_DIST	1024
+
+/*
+ * Rough cost of coding a match in a compressed stream, in bytes. Used to
+ * scale up the match coverage so the target ratio is hit after the
+ * compressor has paid for its match tokens.
+ */
+#define CP_MATCH_COST	8
+
+static void fill_literals(struct frand_state *fs, uint8_t *p,
+			  unsigned int len, const uint8_t *alphabet,
+			  unsigned int nsym)
+{
+	uint64_t r = 0;
+	unsigned int i;
+
+	if (nsym == 256) {
+		__fill_random_buf(p, len, __rand(fs));
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		if (!(i & 7))
+			r = __rand(fs);
+		p[i] = alphabet[((r & 0xff) * nsym) >> 8];
+		r >>= 8;
+	}
+}
+
+/*
+ * Fraction of the data to cover with matches, so that what's left after
+ * the compressor has replaced them with match tokens is 'ratio'.
+ */
+static double match_fraction(double ratio)
+{
+	const double avg_match = (CP_MIN_MATCH + CP_MAX_MATCH) / 2.0;
+	double match;
+
+	match = (1.0 - ratio) / (1.0 - CP_MATCH_COST / avg_match);
+	return min(match, 0.98);
+}
+
+/*
+ * Pick the alphabet size for the literals, so that together with the
+ * matches the data compresses down to 'ratio' of its size.
+ */
+static unsigned int literal_symbols(double ratio, double match)
+{
+	double bits = 8.0 * ratio / (1.0 - match);
+	unsigned int nsym;
+
+	nsym = pow(2.0, bits) + 0.5;
+	if (nsym < 2)
+		nsym = 2;
+	else if (nsym > 256)
+		nsym = 256;
+
+	return nsym;
+}
+
+void compress_pool_generate(uint8_t *buf, unsigned int size,
+			    unsigned int mode, unsigned int percentage,
+			    uint64_t seed)
+{
+	unsigned int i, nsym = 256, lit_max, pos;
+	struct frand_state fs;
+	uint8_t alphabet[256];
+	double ratio, match;
+
+	init_rand_seed(&fs, seed, true);
+
+	/*
+	 * 'ratio' is the fraction of the data left after compression,
+	 * 'match' the fraction of the pool that is covered by matches.
+	 */
+	ratio = (100 - percentage) / 100.0;
+	if (mode == COMPRESS_MODE_ENTROPY) {
+		match = match_fraction((1.0 + ratio) / 2.0);
+		nsym = literal_symbols(ratio, match);
+
+		for (i = 0; i < 256; i++)
+			alphabet[i] = i;
+		for (i = 255; i > 0; i--) {
+			unsigned int j = rand_between(&fs, 0, i);
+			uint8_t tmp = alphabet[i];
+
+			alphabet[i] = alphabet[j];
+			alphabet[j] = tmp;
+		}
+	} else
+		match = match_fraction(ratio);
+
+	if (match > 0.0)
+		lit_max = (CP_MIN_MATCH + CP_MAX_MATCH) * (1.0 - match) / match;
+	else
+		lit_max = size;
+
+	pos = 0;
+	while (pos < size) {
+		unsigned int lit, mlen, dist;
+
+		lit = rand_between(&fs, 0, lit_max);
+		if (pos + lit < CP_MIN_DIST)
+			lit = CP_MIN_DIST;
+		lit = min(lit, size - pos);
+		fill_literals(&fs, buf + pos, lit, alphabet, nsym);
+		pos += lit;
+
+		if (match <= 0.0 || pos == size)
+			continue;
+
+		mlen = rand_between(&fs, CP_MIN_MATCH, CP_MAX_MATCH);
+		mlen = min(mlen, size - pos);
+		dist = rand_between(&fs, CP_MIN_DIST, min(pos, (unsigned int) CP_MAX_DIST));
+
+		/* byte at a time, as the source may overlap the copy */
+		for (i = 0; i < mlen; i++)
+			buf[pos + i] = buf[pos + i - dist];
+		pos += mlen;
+	}
+}
+
+int compress_pool_init(struct compress_pool *cp, unsigned int mode,
+		       unsigned int percentage, uint64_t seed)
+{
+	cp->size = COMPRESS_POOL_SIZE;
+	cp->align = 1;
+	cp->shared = false;
+	cp->buf = malloc(cp->size);
+	if (!cp->buf)
+		return 1;
+
+	compress_pool_generate(cp->buf, cp->size, mode, percentage, seed);
+	return 0;
+}
+
+void compress_pool_exit(struct compress_pool *cp)
+{
+	if (!cp->shared)
+		free(cp->buf);
+	cp->buf = NULL;
+}
+
+void compress_pool_fill(struct compress_pool *cp, void *buf, unsigned int len,
+			uint64_t seed)
+{
+	uint8_t *dst = buf;
+
+	while (len) {
+		unsigned int i, off, this_len = min(len, cp->size / 2);
+		uint64_t hash = __hash_u64(seed);
+		uint8_t x = seed, a = seed >> 8;
+		const uint8_t *src;
+
+		off = (hash >> 20) % ((cp->size - this_len) / cp->align + 1);
+		off *= cp->align;
+		src = cp->buf + off;
+
+		for (i = 0; i < this_len; i++)
+			dst[i] = (src[i] ^ x) + a;
+
+		dst += this_len;
+		len -= this_len;
+		seed = hash;
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef FIO_COMPRESS_POOL_H
+#define FIO_COMPRESS_POOL_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+/*
+ * How compressible buffer contents are generated
+ */
+enum {
+	COMPRESS_MODE_PAD = 0,		/* random data, then zeroes/pattern */
+	COMPRESS_MODE_LZ,		/* random literals and repeated matches */
+	COMPRESS_MODE_ENTROPY,		/* reduced entropy literals and matches */
+};
+
+#define COMPRESS_POOL_SIZE	(1024 * 1024)
+
+struct compress_pool {
+	uint8_t *buf;
+	unsigned int size;
+	unsigned int align;	/* granularity of fill offsets */
+	bool shared;		/* not owned, see corpus.c */
+};
+
+extern void compress_pool_generate(uint8_t *buf, unsigned int size,
+				   unsigned int mode, unsigned int percentage,
+				   uint64_t seed);
+extern int compress_pool_init(struct compress_pool *, unsigned int mode,
+			      unsigned int percentage, uint64_t seed);
+extern void compress_pool_exit(struct compress_pool *);
+extern void compress_pool_fill(struct compress_pool *, void *buf,
+			       unsigned int len, uint64_t seed);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Random permutation of an arbitrary range using a balanced Feistel network.
+ *
+ * The network is a bijection on 2 * half_bits bit values, the smallest even
+ * width that covers nr_vals. Outputs that fall outside the range are fed
+ * through the network again ("cycle walking") until one lands inside it,
+ * which keeps the mapping a bijection on 0 .. nr_vals - 1. The domain is
+ * less than 4 * nr_vals, so that takes fewer than 4 rounds on average.
+ *
+ * Unlike the LFSR, the state is just the key schedule and a position, and
+ * any position can be computed directly.
+ */
+#include "feistel.h"
+
+static uint64_t feistel_mix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static uint64_t feistel_encrypt(const struct fio_feistel *fp, uint64_t x)
+{
+	uint64_t l = x >> fp->half_bits;
+	uint64_t r = x & fp->half_mask;
+	int i;
+
+	for (i = 0; i < FEISTEL_ROUNDS; i++) {
+		uint64_t t = r;
+
+		r = l ^ (feistel_mix(r ^ fp->keys[i]) & fp->half_mask);
+		l = t;
+	}
+
+	return (l << fp->half_bits) | r;
+}
+
+/*
+ * Return the value at position @pos of the permutation.
+ */
+uint64_t feistel_permute(const struct fio_feistel *fp, uint64_t pos)
+{
+	uint64_t x = pos;
+
+	if (fp->nr_vals <= 1)
+		return 0;
+
+	do {
+		x = feistel_encrypt(fp, x);
+	} while (x >= fp->nr_vals);
+
+	return x;
+}
+
+/*
+ * Return the next value of the permutation in @val, or 1 if the end of
+ * this walker's range has been reached.
+ */
+int feistel_next(struct fio_feistel *fp, uint64_t *val)
+{
+	if (fp->pos >= fp->end)
+		return 1;
+
+	*val = feistel_permute(fp, fp->pos++);
+	return 0;
+}
+
+void feistel_reset(struct fio_feistel *fp)
+{
+	fp->pos = fp->start;
+}
+
+/*
+ * Set up a permutation of 0 .. @nr_vals - 1 and walk positions @start to
+ * @end of it.
+ */
+int feistel_init(struct fio_feistel *fp, uint64_t nr_vals, uint64_t seed,
+		 uint64_t start, uint64_t end)
+{
+	unsigned int bits = 2;
+	int i;
+
+	if (!nr_vals || start > end || end > nr_vals)
+		return 1;
+
+	while (bits < 64 && (1ULL << bits) < nr_vals)
+		bits++;
+	if (bits & 1)
+		bits++;
+
+	fp->nr_vals = nr_vals;
+	fp->half_bits = bits / 2;
+	fp->half_mask = (1ULL << fp->half_bits) - 1;
+
+	for (i = 0; i < FEISTEL_ROUNDS; i++) {
+		seed += 0x9e3779b97f4a7c15ULL;
+		fp->keys[i] = feistel_mix(seed);
+	}
+
+	fp->start = start;
+	fp->end = end;
+	feistel_reset(fp);
+	return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef FIO_FEISTEL_H
+#define FIO_FEISTEL_H
+
+#include <inttypes.h>
+
+#define FEISTEL_ROUNDS	4
+
+/*
+ * Pseudo random permutation of 0 .. nr_vals - 1, walked from position
+ * 'start' up to (not including) 'end'. Position i always maps to the same
+ * value for a given seed, so callers can split one permutation between
+ * them by giving each a different range.
+ */
+struct fio_feistel {
+	uint64_t nr_vals;
+	unsigned int half_bits;
+	uint64_t half_mask;
+	uint64_t keys[FEISTEL_ROUNDS];
+	uint64_t start;
+	uint64_t end;
+	uint64_t pos;
+};
+
+int feistel_init(struct fio_feistel *fp, uint64_t nr_vals, uint64_t seed,
+		 uint64_t start, uint64_t end);
+void feistel_reset(struct fio_feistel *fp);
+uint64_t feistel_permute(const struct fio_feistel *fp, uint64_t pos);
+int feistel_next(struct fio_feistel *fp, uint64_t *val);
+
+#endif
@@ -10,6 +10,11 @@
 #define FRAND64_MAX	(-1ULL)
 #define FRAND64_MAX_PLUS_ONE	(1.0 * (1ULL << 32) * (1ULL << 32))
 
+/*
+ * Number of independent generator lanes used by __fill_random_buf()
+ */
+#define RAND_BUF_LANES		8
+
 struct taus88_state {
 	unsigned int s1, s2, s3;
 };
@@ -163,6 +168,7 @@ static inline uint64_t __get_next_seed(struct frand_state *fs)
 extern void init_rand(struct frand_state *, bool);
 extern void init_rand_seed(struct frand_state *, uint64_t seed, bool);
 void __init_rand64(struct taus258_state *state, uint64_t seed);
+extern void __fill_random_buf_serial(void *buf, unsigned int len, uint64_t seed);
 extern void __fill_random_buf(void *buf, unsigned int len, uint64_t seed);
 extern uint64_t fill_random_buf(struct frand_state *, void *buf, unsigned int len);
 extern void __fill_random_buf_percentage(uint64_t, void *, unsigned int, unsigned int, unsigned int, char *, unsigned int);
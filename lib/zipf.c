@@ -1,4 +1,6 @@
 #include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include "zipf.h"
 #include "../minmax.h"
@@ -6,6 +8,45 @@
 
 #define ZIPF_MAX_GEN	10000000UL
 
+/*
+ * Ranks below ZIPF_HEAD get an exact slot in the alias table, the rest of
+ * a zipf (and all of a pareto) is drawn from ZIPF_TAIL_SLICES equally
+ * likely slices of the inverse CDF.
+ */
+#define ZIPF_HEAD		4096
+#define ZIPF_TAIL_SLICES	4096
+
+enum {
+	ZIPF_TABLE_ZIPF,
+	ZIPF_TABLE_PARETO,
+};
+
+/*
+ * Sampling tables only depend on the distribution parameters, so they are
+ * cached and shared by every state using the same ones. A table built
+ * before fork is shared with all jobs.
+ */
+struct zipf_table {
+	struct zipf_table *next;
+	unsigned int refs;
+
+	unsigned int type;
+	uint64_t nranges;
+	double param;
+
+	/* alias table: nr_head exact ranks, plus one slot for the tail */
+	unsigned int nr_slots;
+	unsigned int nr_head;
+	uint32_t *thresh;
+	uint32_t *alias;
+
+	/* ZIPF_TAIL_SLICES + 1 slice boundaries, in ranks */
+	double *tail;
+};
+
+static struct zipf_table *zipf_tables;
+static pthread_mutex_t zipf_tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static void zipf_update(struct zipf_state *zs)
 {
 	uint64_t to_gen;
@@ -22,6 +63,231 @@ static void zipf_update(struct zipf_state *zs)
 		zs->zetan += pow(1.0 / (double) (i + 1), zs->theta);
 }
 
+/*
+ * Integral of x^-theta over [a, b]
+ */
+static double zipf_integral(double a, double b, double theta)
+{
+	if (theta == 1.0)
+		return log(b / a);
+
+	return (pow(b, 1.0 - theta) - pow(a, 1.0 - theta)) / (1.0 - theta);
+}
+
+/*
+ * Fill the tail slices for ranks [nr_head, nranges). Zipf ranks are
+ * treated as a continuous x^-theta density around each (1 based) rank,
+ * pareto follows its inverse CDF (nranges - 1) * u^pow directly.
+ */
+static void zipf_fill_tail(struct zipf_table *zt, double pareto_pow)
+{
+	double a = zt->nr_head + 0.5, b = zt->nranges + 0.5;
+	double theta = zt->param, e = 1.0 - theta;
+	unsigned int i;
+
+	for (i = 0; i <= ZIPF_TAIL_SLICES; i++) {
+		double u = (double) i / ZIPF_TAIL_SLICES, x;
+
+		if (zt->type == ZIPF_TABLE_PARETO)
+			x = (zt->nranges - 1) * pow(u, pareto_pow);
+		else if (theta == 1.0)
+			x = a * pow(b / a, u) - 0.5;
+		else
+			x = pow(pow(a, e) + u * (pow(b, e) - pow(a, e)), 1.0 / e) - 0.5;
+
+		zt->tail[i] = x;
+	}
+}
+
+/*
+ * Vose's alias method over nr_slots outcomes with probabilities 'p'
+ */
+static bool zipf_build_alias(struct zipf_table *zt, double *p)
+{
+	unsigned int n = zt->nr_slots, nr_small = 0, nr_large = 0, i;
+	unsigned int *small, *large;
+
+	small = malloc(2 * n * sizeof(unsigned int));
+	if (!small)
+		return false;
+	large = small + n;
+
+	for (i = 0; i < n; i++) {
+		p[i] *= n;
+		if (p[i] < 1.0)
+			small[nr_small++] = i;
+		else
+			large[nr_large++] = i;
+	}
+
+	while (nr_small && nr_large) {
+		unsigned int s = small[--nr_small], l = large[nr_large - 1];
+
+		zt->thresh[s] = p[s] * FRAND32_MAX;
+		zt->alias[s] = l;
+		p[l] -= 1.0 - p[s];
+		if (p[l] < 1.0) {
+			nr_large--;
+			small[nr_small++] = l;
+		}
+	}
+
+	/* leftovers are 1.0 up to rounding */
+	while (nr_large) {
+		i = large[--nr_large];
+		zt->thresh[i] = FRAND32_MAX;
+		zt->alias[i] = i;
+	}
+	while (nr_small) {
+		i = small[--nr_small];
+		zt->thresh[i] = FRAND32_MAX;
+		zt->alias[i] = i;
+	}
+
+	free(small);
+	return true;
+}
+
+static struct zipf_table *zipf_table_build(unsigned int type,
+					   uint64_t nranges, double param)
+{
+	struct zipf_table *zt;
+	double *p = NULL, zetan = 0.0;
+	unsigned int i;
+
+	zt = calloc(1, sizeof(*zt));
+	if (!zt)
+		return NULL;
+
+	zt->refs = 1;
+	zt->type = type;
+	zt->nranges = nranges;
+	zt->param = param;
+
+	if (type == ZIPF_TABLE_ZIPF)
+		zt->nr_head = min(nranges, (uint64_t) ZIPF_HEAD);
+	zt->nr_slots = zt->nr_head + (zt->nr_head < nranges);
+
+	zt->thresh = malloc(zt->nr_slots * sizeof(uint32_t));
+	zt->alias = malloc(zt->nr_slots * sizeof(uint32_t));
+	p = malloc(zt->nr_slots * sizeof(double));
+	if (zt->nr_head < nranges)
+		zt->tail = malloc((ZIPF_TAIL_SLICES + 1) * sizeof(double));
+	if (!zt->thresh || !zt->alias || !p ||
+	    (zt->nr_head < nranges && !zt->tail))
+		goto err;
+
+	for (i = 0; i < zt->nr_head; i++) {
+		p[i] = pow(1.0 / (i + 1), param);
+		zetan += p[i];
+	}
+	if (zt->nr_head < nranges) {
+		if (type == ZIPF_TABLE_ZIPF) {
+			p[zt->nr_head] = zipf_integral(zt->nr_head + 0.5,
+						       nranges + 0.5, param);
+			zetan += p[zt->nr_head];
+			zipf_fill_tail(zt, 0.0);
+		} else {
+			p[0] = zetan = 1.0;
+			zipf_fill_tail(zt, log(param) / log(1.0 - param));
+		}
+	}
+	for (i = 0; i < zt->nr_slots; i++)
+		p[i] /= zetan;
+
+	if (!zipf_build_alias(zt, p))
+		goto err;
+
+	free(p);
+	return zt;
+err:
+	free(p);
+	free(zt->thresh);
+	free(zt->alias);
+	free(zt->tail);
+	free(zt);
+	return NULL;
+}
+
+static struct zipf_table *zipf_table_get(unsigned int type, uint64_t nranges,
+					 double param)
+{
+	struct zipf_table *zt;
+
+	pthread_mutex_lock(&zipf_tables_lock);
+
+	for (zt = zipf_tables; zt; zt = zt->next) {
+		if (zt->type == type && zt->nranges == nranges &&
+		    zt->param == param) {
+			zt->refs++;
+			goto out;
+		}
+	}
+
+	zt = zipf_table_build(type, nranges, param);
+	if (zt) {
+		zt->next = zipf_tables;
+		zipf_tables = zt;
+	}
+out:
+	pthread_mutex_unlock(&zipf_tables_lock);
+	return zt;
+}
+
+static void zipf_table_put(struct zipf_table *zt)
+{
+	struct zipf_table **prev;
+
+	pthread_mutex_lock(&zipf_tables_lock);
+
+	if (--zt->refs) {
+		pthread_mutex_unlock(&zipf_tables_lock);
+		return;
+	}
+
+	for (prev = &zipf_tables; *prev != zt; prev = &(*prev)->next)
+		;
+	*prev = zt->next;
+
+	pthread_mutex_unlock(&zipf_tables_lock);
+
+	free(zt->thresh);
+	free(zt->alias);
+	free(zt->tail);
+	free(zt);
+}
+
+/*
+ * O(1) draw of a 0 based rank: one alias table pick, and for the tail
+ * one more draw to pick a slice and a spot inside it.
+ */
+static uint64_t zipf_table_next(struct zipf_state *zs)
+{
+	const struct zipf_table *zt = zs->table;
+	uint64_t r = (uint64_t) __rand(&zs->rand) * zt->nr_slots;
+	unsigned int slot = r >> 32;
+	const double *t;
+	uint64_t val;
+	uint32_t s;
+
+	if (!zt->nr_head)
+		goto tail;
+	if ((uint32_t) r > zt->thresh[slot])
+		slot = zt->alias[slot];
+	if (slot < zt->nr_head)
+		return slot;
+tail:
+	s = __rand(&zs->rand);
+	t = &zt->tail[s >> 20];
+	val = t[0] + (s & ((1U << 20) - 1)) * (1.0 / (1U << 20)) * (t[1] - t[0]);
+	if (val < zt->nr_head)
+		val = zt->nr_head;
+	else if (val >= zt->nranges)
+		val = zt->nranges - 1;
+
+	return val;
+}
+
 static void shared_rand_init(struct zipf_state *zs, uint64_t nranges,
 			     double center, unsigned int seed)
 {
@@ -42,10 +308,12 @@ void zipf_init(struct zipf_state *zs, uint64_t nranges, double theta,
 	zs->theta = theta;
 	zs->zeta2 = pow(1.0, zs->theta) + pow(0.5, zs->theta);
 
-	zipf_update(zs);
+	zs->table = zipf_table_get(ZIPF_TABLE_ZIPF, nranges, theta);
+	if (!zs->table)
+		zipf_update(zs);
 }
 
-uint64_t zipf_next(struct zipf_state *zs)
+static uint64_t zipf_next_pow(struct zipf_state *zs)
 {
 	double alpha, eta, rand_uni, rand_z;
 	unsigned long long n = zs->nranges;
@@ -64,7 +332,17 @@ uint64_t zipf_next(struct zipf_state *zs)
 	else
 		val = 1 + (unsigned long long)(n * pow(eta*rand_uni - eta + 1.0, alpha));
 
-	val--;
+	return val - 1;
+}
+
+uint64_t zipf_next(struct zipf_state *zs)
+{
+	uint64_t val;
+
+	if (zs->table)
+		val = zipf_table_next(zs);
+	else
+		val = zipf_next_pow(zs);
 
 	if (!zs->disable_hash)
 		val = __hash_u64(val);
@@ -77,14 +355,20 @@ void pareto_init(struct zipf_state *zs, uint64_t nranges, double h,
 {
 	shared_rand_init(zs, nranges, center, seed);
 	zs->pareto_pow = log(h) / log(1.0 - h);
+	zs->table = zipf_table_get(ZIPF_TABLE_PARETO, nranges, h);
 }
 
 uint64_t pareto_next(struct zipf_state *zs)
 {
-	double rand = (double) __rand(&zs->rand) / (double) FRAND32_MAX;
 	unsigned long long n;
 
-	n = (zs->nranges - 1) * pow(rand, zs->pareto_pow);
+	if (zs->table)
+		n = zipf_table_next(zs);
+	else {
+		double rand = (double) __rand(&zs->rand) / (double) FRAND32_MAX;
+
+		n = (zs->nranges - 1) * pow(rand, zs->pareto_pow);
+	}
 
 	if (!zs->disable_hash)
 		n = __hash_u64(n);
@@ -96,3 +380,25 @@ void zipf_disable_hash(struct zipf_state *zs)
 {
 	zs->disable_hash = true;
 }
+
+/*
+ * Go back to computing every value with pow(), mostly for comparing the
+ * two in t/genzipf.
+ */
+void zipf_disable_table(struct zipf_state *zs)
+{
+	if (!zs->table)
+		return;
+
+	zipf_table_put(zs->table);
+	zs->table = NULL;
+	if (zs->theta != 0.0)
+		zipf_update(zs);
+}
+
+void zipf_free(struct zipf_state *zs)
+{
+	if (zs->table)
+		zipf_table_put(zs->table);
+	zs->table = NULL;
+}
@@ -5,6 +5,8 @@
 #include "rand.h"
 #include "types.h"
 
+struct zipf_table;
+
 struct zipf_state {
 	uint64_t nranges;
 	double theta;
@@ -14,6 +16,7 @@ struct zipf_state {
 	struct frand_state rand;
 	uint64_t rand_off;
 	bool disable_hash;
+	struct zipf_table *table;
 };
 
 void zipf_init(struct zipf_state *zs, uint64_t nranges, double theta,
@@ -24,5 +27,7 @@ void pareto_init(struct zipf_state *zs, uint64_t nranges, double h,
 		 double center, unsigned int seed);
 uint64_t pareto_next(struct zipf_state *zs);
 void zipf_disable_hash(struct zipf_state *zs);
+void zipf_disable_table(struct zipf_state *zs);
+void zipf_free(struct zipf_state *zs);
 
 #endif
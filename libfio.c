@@ -120,6 +120,7 @@ void clear_io_state(struct thread_data *td, int all)
 		fio_file_clear_done(f);
 		f->file_offset = get_start_offset(td, f);
 	}
+	reset_active_files(td);
 
 	/*
 	 * Re-Seed random number generator if rand_repeatable is true
@@ -195,6 +195,188 @@ static void free_mem_mmap(struct thread_data *td, size_t total_mem)
 	}
 }
 
+#ifdef CONFIG_HAVE_MEMFD_HUGETLB
+/* glibc has MFD_HUGETLB, but the size encoding lives in linux/memfd.h */
+#ifndef MFD_HUGE_SHIFT
+#define MFD_HUGE_SHIFT	MAP_HUGE_SHIFT
+#define MFD_HUGE_MASK	MAP_HUGE_MASK
+#endif
+#endif
+
+static int alloc_mem_memfd(struct thread_data *td, size_t total_mem)
+{
+#ifdef CONFIG_HAVE_MEMFD_HUGETLB
+	unsigned int flags = MFD_CLOEXEC | MFD_HUGETLB;
+	unsigned long long psize = td->o.hugepage_size;
+	struct stat sb;
+
+	/*
+	 * Without an explicit hugepage-size, take the default huge page
+	 * size of the system.
+	 */
+	if (fio_option_is_set(&td->o, hugepage_size)) {
+		if (!psize || (psize & (psize - 1))) {
+			log_err("fio: hugepage-size must be a power of 2\n");
+			return 1;
+		}
+		flags |= (__builtin_ctzll(psize) & MFD_HUGE_MASK) << MFD_HUGE_SHIFT;
+	}
+
+	td->mmapfd = memfd_create("fio-iomem", flags);
+	if (td->mmapfd < 0) {
+		td_verror(td, errno, "memfd_create");
+		if (errno == EINVAL)
+			log_err("fio: check that hugepage-size is a huge page "
+				"size supported by the system\n");
+		return 1;
+	}
+
+	if (fstat(td->mmapfd, &sb) < 0) {
+		td_verror(td, errno, "fstat memfd");
+		goto err;
+	}
+
+	/* hugetlbfs reports the page size as the block size */
+	psize = sb.st_blksize;
+	total_mem = (total_mem + psize - 1) & ~(psize - 1);
+
+	if (ftruncate(td->mmapfd, total_mem) < 0) {
+		td_verror(td, errno, "truncate memfd");
+		goto err;
+	}
+
+	td->orig_buffer = mmap(NULL, total_mem, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, td->mmapfd, 0);
+	dprint(FD_MEM, "memfd mmap %llu/%llu %p\n",
+		(unsigned long long) total_mem, psize, td->orig_buffer);
+	if (td->orig_buffer == MAP_FAILED) {
+		td_verror(td, errno, "mmap memfd");
+		if (errno == ENOMEM)
+			log_err("fio: no huge pages available, do you need to "
+				"allocate some? See HOWTO.\n");
+		goto err;
+	}
+
+	td->orig_buffer_mapped = total_mem;
+	return 0;
+err:
+	td->orig_buffer = NULL;
+	close(td->mmapfd);
+	td->mmapfd = -1;
+	return 1;
+#else
+	log_err("fio: memfd huge pages not supported\n");
+	return 1;
+#endif
+}
+
+#define THP_SIZE	(2 * 1024 * 1024UL)
+
+/*
+ * Map a THP aligned anonymous area and ask for huge pages for it. Fault it
+ * all in up front, so the pages are there before I/O starts and the
+ * report shows what we actually got.
+ */
+static int alloc_mem_thp(struct thread_data *td, size_t total_mem)
+{
+#ifdef CONFIG_HAVE_THP
+	uintptr_t start, aligned;
+	size_t map_len;
+	char *p;
+
+	total_mem = (total_mem + THP_SIZE - 1) & ~(THP_SIZE - 1);
+	map_len = total_mem + THP_SIZE;
+
+	p = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+			OS_MAP_ANON | MAP_PRIVATE, -1, 0);
+	if (p == MAP_FAILED) {
+		td_verror(td, errno, "mmap");
+		return 1;
+	}
+
+	start = (uintptr_t) p;
+	aligned = (start + THP_SIZE - 1) & ~(THP_SIZE - 1);
+	if (aligned != start)
+		munmap(p, aligned - start);
+	munmap((void *) (aligned + total_mem),
+		start + map_len - (aligned + total_mem));
+
+	td->orig_buffer = (void *) aligned;
+	td->orig_buffer_mapped = total_mem;
+
+	if (madvise(td->orig_buffer, total_mem, MADV_HUGEPAGE) < 0)
+		log_info("fio: madvise(MADV_HUGEPAGE) failed: %s\n",
+				strerror(errno));
+
+	memset(td->orig_buffer, 0, total_mem);
+	dprint(FD_MEM, "thp mmap %llu %p\n", (unsigned long long) total_mem,
+						td->orig_buffer);
+	return 0;
+#else
+	log_err("fio: transparent huge pages not supported\n");
+	return 1;
+#endif
+}
+
+static void free_mem_huge(struct thread_data *td)
+{
+	dprint(FD_MEM, "munmap huge %llu %p\n",
+		(unsigned long long) td->orig_buffer_mapped, td->orig_buffer);
+	munmap(td->orig_buffer, td->orig_buffer_mapped);
+	if (td->o.mem_type == MEM_MEMFDHUGE && td->mmapfd != -1) {
+		close(td->mmapfd);
+		td->mmapfd = -1;
+	}
+	td->orig_buffer_mapped = 0;
+}
+
+/*
+ * Sum up how much of the buffer area is backed by huge pages, going by
+ * the smaps entries that overlap it.
+ */
+static void report_huge_io_mem(struct thread_data *td, size_t total_mem)
+{
+	unsigned long long huge_kb = 0, page_kb = 0;
+	uintptr_t start = (uintptr_t) td->orig_buffer;
+	uintptr_t end = start + total_mem;
+	bool in_range = false;
+	char line[256];
+	FILE *f;
+
+	f = fopen("/proc/self/smaps", "r");
+	if (!f)
+		return;
+
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long lo, hi, kb;
+		char key[64];
+
+		if (sscanf(line, "%llx-%llx ", &lo, &hi) == 2) {
+			in_range = lo < end && hi > start;
+			continue;
+		}
+		if (!in_range || sscanf(line, "%63s %llu kB", key, &kb) != 2)
+			continue;
+
+		if (!strcmp(key, "AnonHugePages:") ||
+		    !strcmp(key, "Shared_Hugetlb:") ||
+		    !strcmp(key, "Private_Hugetlb:"))
+			huge_kb += kb;
+		else if (!strcmp(key, "KernelPageSize:") && kb > page_kb)
+			page_kb = kb;
+	}
+
+	fclose(f);
+
+	/* THP areas report the base page size, huge pages are 2M there */
+	if (td->o.mem_type == MEM_THP && huge_kb)
+		page_kb = THP_SIZE >> 10;
+
+	log_info("fio: %s: %llu of %llu KiB of I/O buffers on huge pages "
+		 "(%llu KiB pages)\n", td->o.name, huge_kb,
+		 (unsigned long long) total_mem >> 10, page_kb);
+}
+
 static int alloc_mem_malloc(struct thread_data *td, size_t total_mem)
 {
 	td->orig_buffer = malloc(total_mem);
@@ -323,6 +505,10 @@ int allocate_io_mem(struct thread_data *td)
 		ret = alloc_mem_mmap(td, total_mem);
 	else if (td->o.mem_type == MEM_CUDA_MALLOC)
 		ret = alloc_mem_cudamalloc(td, total_mem);
+	else if (td->o.mem_type == MEM_MEMFDHUGE)
+		ret = alloc_mem_memfd(td, total_mem);
+	else if (td->o.mem_type == MEM_THP)
+		ret = alloc_mem_thp(td, total_mem);
 	else {
 		log_err("fio: bad mem type: %d\n", td->o.mem_type);
 		ret = 1;
@@ -330,6 +516,9 @@ int allocate_io_mem(struct thread_data *td)
 
 	if (ret)
 		td_verror(td, ENOMEM, "iomem allocation");
+	else if (td->o.mem_type == MEM_MEMFDHUGE || td->o.mem_type == MEM_THP ||
+		 td->o.mem_type == MEM_SHMHUGE || td->o.mem_type == MEM_MMAPHUGE)
+		report_huge_io_mem(td, total_mem);
 
 	return ret;
 }
@@ -354,6 +543,8 @@ void free_io_mem(struct thread_data *td)
 		free_mem_mmap(td, total_mem);
 	else if (td->o.mem_type == MEM_CUDA_MALLOC)
 		free_mem_cudamalloc(td);
+	else if (td->o.mem_type == MEM_MEMFDHUGE || td->o.mem_type == MEM_THP)
+		free_mem_huge(td);
 	else
 		log_err("Bad memory type %u\n", td->o.mem_type);
 
@@ -0,0 +1,309 @@
+/*
+ * Keep the hot memory of a job on one NUMA node: the node its CPUs are
+ * on, or the node of the device it does I/O to.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <libgen.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "fio.h"
+#include "numa_place.h"
+
+#include <numaif.h>
+
+#define NUMA_QUERY_BATCH	256
+
+enum {
+	NUMA_MEM_IO_U = 0,
+	NUMA_MEM_BUFFERS,
+	NUMA_MEM_QUEUES,
+	NUMA_MEM_STATS,
+	NUMA_MEM_NR,
+};
+
+static const char *numa_mem_names[NUMA_MEM_NR] = {
+	"io_u", "buffers", "queues", "stats",
+};
+
+struct numa_mem_count {
+	unsigned long pages[NUMA_MEM_NR];
+	unsigned long remote[NUMA_MEM_NR];
+};
+
+/*
+ * Walk up from the sysfs entry of a block device until a numa_node
+ * attribute shows up. That is normally the PCI function the device
+ * hangs off, -1 if the platform doesn't know.
+ */
+static int blockdev_numa_node(dev_t dev)
+{
+	char path[PATH_MAX + 16], real[PATH_MAX];
+	char *p;
+
+	snprintf(path, sizeof(path), "/sys/dev/block/%u:%u", major(dev),
+			minor(dev));
+	if (!realpath(path, real))
+		return -1;
+
+	while ((p = strrchr(real, '/')) != NULL && p != real) {
+		FILE *f;
+		int node;
+
+		snprintf(path, sizeof(path), "%s/numa_node", real);
+		f = fopen(path, "r");
+		if (f) {
+			if (fscanf(f, "%d", &node) != 1)
+				node = -1;
+			fclose(f);
+			return node;
+		}
+		*p = '\0';
+	}
+
+	return -1;
+}
+
+static int file_numa_node(struct fio_file *f)
+{
+	struct stat sb;
+	char *dir;
+	int ret;
+
+	if (f->filetype == FIO_TYPE_CHAR || f->filetype == FIO_TYPE_PIPE)
+		return -1;
+
+	if (!stat(f->file_name, &sb)) {
+		if (S_ISBLK(sb.st_mode))
+			return blockdev_numa_node(sb.st_rdev);
+		return blockdev_numa_node(sb.st_dev);
+	}
+
+	/* not laid out yet, use the file system it will live on */
+	dir = strdup(f->file_name);
+	if (!dir)
+		return -1;
+	ret = stat(dirname(dir), &sb);
+	free(dir);
+
+	return ret ? -1 : blockdev_numa_node(sb.st_dev);
+}
+
+static int job_device_node(struct thread_data *td)
+{
+	struct fio_file *f;
+	unsigned int i;
+	int node = -1;
+
+	for_each_file(td, f, i) {
+		int fnode = file_numa_node(f);
+
+		if (fnode < 0)
+			continue;
+		if (node < 0)
+			node = fnode;
+		else if (node != fnode) {
+			log_info("fio: %s: files on several NUMA nodes, using "
+				 "node %d\n", td->o.name, node);
+			break;
+		}
+	}
+
+	return node;
+}
+
+/*
+ * Node of the CPUs the job may run on. If those span more than one node,
+ * return the node of the CPU we are on now and set 'spans'.
+ */
+static int job_cpu_node(bool *spans)
+{
+	struct bitmask *cpus;
+	int i, node = -1;
+
+	*spans = false;
+
+	cpus = numa_allocate_cpumask();
+	if (!cpus)
+		return -1;
+
+	if (!numa_sched_getaffinity(0, cpus)) {
+		for (i = 0; i < numa_num_possible_cpus(); i++) {
+			int cnode;
+
+			if (!numa_bitmask_isbitset(cpus, i))
+				continue;
+			cnode = numa_node_of_cpu(i);
+			if (cnode < 0)
+				continue;
+			if (node < 0)
+				node = cnode;
+			else if (node != cnode) {
+				*spans = true;
+				break;
+			}
+		}
+	}
+
+	numa_free_cpumask(cpus);
+
+	if (*spans || node < 0) {
+		i = sched_getcpu();
+		if (i >= 0)
+			node = numa_node_of_cpu(i);
+	}
+
+	return node;
+}
+
+/*
+ * Pick the node for the job and steer CPU and memory policy towards it,
+ * before any of the per job memory is allocated. Explicit cpus_allowed,
+ * numa_cpu_nodes and numa_mem_policy settings are left alone.
+ */
+int fio_numa_place_job(struct thread_data *td)
+{
+	struct thread_options *o = &td->o;
+	bool user_cpus, spans;
+	int node = -1, cpu_node;
+
+	td->numa_node = -1;
+	if (o->numa_placement == FIO_NUMA_PLACE_NONE)
+		return 0;
+
+	if (numa_available() < 0) {
+		td_verror(td, errno, "Does not support NUMA API\n");
+		return 1;
+	}
+
+	user_cpus = fio_option_is_set(o, cpumask) ||
+			fio_option_is_set(o, numa_cpunodes);
+	cpu_node = job_cpu_node(&spans);
+
+	if (o->numa_placement == FIO_NUMA_PLACE_DEVICE) {
+		node = job_device_node(td);
+		if (node < 0)
+			log_info("fio: %s: no NUMA node known for the device, "
+				 "using the CPU node\n", o->name);
+	}
+	if (node < 0)
+		node = cpu_node;
+	if (node < 0)
+		return 0;
+
+	if (!user_cpus) {
+		if ((spans || node != cpu_node) &&
+		    numa_run_on_node(node) == -1) {
+			td_verror(td, errno, "numa_run_on_node");
+			return 1;
+		}
+	} else if (spans || node != cpu_node)
+		log_info("fio: %s: job CPUs are not all on NUMA node %d\n",
+			 o->name, node);
+
+	if (!fio_option_is_set(o, numa_memnodes))
+		numa_set_preferred(node);
+
+	td->numa_node = node;
+	dprint(FD_MEM, "numa: %s placed on node %d\n", o->name, node);
+	return 0;
+}
+
+/*
+ * Move the pages of [ptr, ptr + len) to the job node if asked to, and
+ * count how many of them are elsewhere.
+ */
+static void numa_place_region(struct thread_data *td, void *ptr, size_t len,
+			      bool move, struct bitmask *mask,
+			      unsigned int type, struct numa_mem_count *c)
+{
+	uintptr_t start = (uintptr_t) ptr & ~page_mask;
+	uintptr_t end = ((uintptr_t) ptr + len + page_mask) & ~page_mask;
+	void *pages[NUMA_QUERY_BATCH];
+	int status[NUMA_QUERY_BATCH];
+	unsigned int i, nr;
+
+	if (!ptr || !len)
+		return;
+
+	if (move && mbind((void *) start, end - start, MPOL_PREFERRED,
+			  mask->maskp, mask->size + 1, MPOL_MF_MOVE) < 0)
+		dprint(FD_MEM, "numa: mbind %p/%lu: %s\n", (void *) start,
+				(unsigned long) (end - start), strerror(errno));
+
+	while (start < end) {
+		for (nr = 0; nr < NUMA_QUERY_BATCH && start < end; nr++) {
+			pages[nr] = (void *) start;
+			start += page_size;
+		}
+
+		if (numa_move_pages(0, nr, pages, NULL, status, 0) < 0)
+			return;
+
+		for (i = 0; i < nr; i++) {
+			/* not faulted in yet */
+			if (status[i] < 0)
+				continue;
+			c->pages[type]++;
+			if (status[i] != td->numa_node)
+				c->remote[type]++;
+		}
+	}
+}
+
+/*
+ * Called once the io_us, their buffers and the engine are set up. Pull
+ * anything that was allocated from memory faulted in elsewhere (malloc
+ * arenas shared by threads, say) over to the job node, and report what
+ * still isn't there. The stats live in the thread area shared with the
+ * parent, they are only reported.
+ */
+void fio_numa_place_memory(struct thread_data *td)
+{
+	struct numa_mem_count c = { };
+	struct bitmask *mask;
+	char buf[256];
+	size_t len = 0;
+	struct io_u *io_u;
+	unsigned int i;
+
+	if (td->o.numa_placement == FIO_NUMA_PLACE_NONE || td->numa_node < 0)
+		return;
+
+	mask = numa_allocate_nodemask();
+	if (!mask)
+		return;
+	numa_bitmask_setbit(mask, td->numa_node);
+
+	io_u_qiter(&td->io_u_all, io_u, i)
+		numa_place_region(td, io_u, sizeof(*io_u), true, mask,
+					NUMA_MEM_IO_U, &c);
+	numa_place_region(td, td->orig_buffer, td->orig_buffer_size, true,
+				mask, NUMA_MEM_BUFFERS, &c);
+	numa_place_region(td, td->io_u_all.io_us,
+				td->io_u_all.max * sizeof(struct io_u *), true,
+				mask, NUMA_MEM_QUEUES, &c);
+	numa_place_region(td, td->io_u_freelist.io_us,
+				td->io_u_freelist.max * sizeof(struct io_u *),
+				true, mask, NUMA_MEM_QUEUES, &c);
+	numa_place_region(td, td->io_u_requeues.ring,
+				td->io_u_requeues.max * sizeof(struct io_u *),
+				true, mask, NUMA_MEM_QUEUES, &c);
+	numa_place_region(td, &td->ts, sizeof(td->ts), false, mask,
+				NUMA_MEM_STATS, &c);
+
+	numa_free_nodemask(mask);
+
+	for (i = 0; i < NUMA_MEM_NR; i++) {
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%s %lu/%lu",
+				i ? ", " : "", numa_mem_names[i], c.remote[i],
+				c.pages[i]);
+	}
+
+	log_info("fio: %s: NUMA node %d, remote pages: %s\n", td->o.name,
+			td->numa_node, buf);
+}
@@ -0,0 +1,24 @@
+#ifndef FIO_NUMA_PLACE_H
+#define FIO_NUMA_PLACE_H
+
+struct thread_data;
+
+#ifdef CONFIG_LIBNUMA
+
+int fio_numa_place_job(struct thread_data *);
+void fio_numa_place_memory(struct thread_data *);
+
+#else
+
+static inline int fio_numa_place_job(struct thread_data *td)
+{
+	return 0;
+}
+
+static inline void fio_numa_place_memory(struct thread_data *td)
+{
+}
+
+#endif
+
+#endif
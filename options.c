@@ -1110,6 +1110,23 @@ static int str_random_distribution_cb(void *data, const char *str)
 	return 0;
 }
 
+static int str_random_pattern_cb(void *data, const char *str)
+{
+	struct thread_data *td = cb_data_to_td(data);
+	struct access_pattern *ap;
+	const char *err;
+
+	ap = apat_parse(str, &err);
+	if (!ap) {
+		log_err("fio: random_pattern: %s\n", err);
+		return 1;
+	}
+
+	apat_free(ap);
+	td->o.random_distribution = FIO_RAND_DIST_PATTERN;
+	return 0;
+}
+
 static int str_steadystate_cb(void *data, const char *str)
 {
 	struct thread_data *td = cb_data_to_td(data);
@@ -2377,10 +2394,26 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 			    .oval = FIO_RAND_GEN_TAUSWORTHE64,
 			    .help = "64-bit Tausworthe variant",
 			  },
+			  { .ival = "feistel",
+			    .oval = FIO_RAND_GEN_FEISTEL,
+			    .help = "Feistel network permutation",
+			  },
 		},
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_RANDOM,
 	},
+	{
+		.name	= "random_partition",
+		.lname	= "Random partition",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct thread_options, random_partition),
+		.help	= "Split one feistel permutation between numjobs clones",
+		.def	= "0",
+		.parent	= "random_generator",
+		.hide	= 1,
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_RANDOM,
+	},
 	{
 		.name	= "random_distribution",
 		.lname	= "Random Distribution",
@@ -2414,10 +2447,24 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 			    .oval = FIO_RAND_DIST_ZONED_ABS,
 			    .help = "Zoned absolute random distribution",
 			  },
+			  { .ival = "pattern",
+			    .oval = FIO_RAND_DIST_PATTERN,
+			    .help = "Composed from random_pattern",
+			  },
 		},
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_RANDOM,
 	},
+	{
+		.name	= "random_pattern",
+		.lname	= "Random pattern",
+		.type	= FIO_OPT_STR_STORE,
+		.off1	= offsetof(struct thread_options, random_pattern),
+		.cb	= str_random_pattern_cb,
+		.help	= "Composable, time varying random offset distribution",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_RANDOM,
+	},
 	{
 		.name	= "percentage_random",
 		.lname	= "Percentage Random",
@@ -2860,6 +2907,18 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 			    .oval = MEM_CUDA_MALLOC,
 			    .help = "Allocate GPU device memory for GPUDirect RDMA",
 			  },
+#endif
+#ifdef CONFIG_HAVE_MEMFD_HUGETLB
+			  { .ival = "memfdhuge",
+			    .oval = MEM_MEMFDHUGE,
+			    .help = "Use memfd_create(2) backed huge pages",
+			  },
+#endif
+#ifdef CONFIG_HAVE_THP
+			  { .ival = "thp",
+			    .oval = MEM_THP,
+			    .help = "Use anonymous mmap with transparent huge pages",
+			  },
 #endif
 		  },
 	},
@@ -3951,6 +4010,18 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_FILE,
 		.def	= "0",
 	},
+	{
+		.name	= "layout_threads",
+		.lname	= "Layout threads",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, layout_threads),
+		.help	= "Number of threads used to lay out and prepopulate files",
+		.minval	= 1,
+		.maxval	= 256,
+		.def	= "1",
+		.category = FIO_OPT_C_FILE,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name	= "allow_file_create",
 		.lname	= "Allow file create",
@@ -4064,6 +4135,30 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_GENERAL,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "numa_placement",
+		.lname	= "NUMA placement",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, numa_placement),
+		.help	= "Keep job memory on the NUMA node of its CPUs or device",
+		.def	= "none",
+		.posval	= {
+			  { .ival = "none",
+			    .oval = FIO_NUMA_PLACE_NONE,
+			    .help = "No automatic placement",
+			  },
+			  { .ival = "cpu",
+			    .oval = FIO_NUMA_PLACE_CPU,
+			    .help = "Node of the job CPUs",
+			  },
+			  { .ival = "device",
+			    .oval = FIO_NUMA_PLACE_DEVICE,
+			    .help = "Node of the device the job does I/O to",
+			  },
+		},
+		.category = FIO_OPT_C_GENERAL,
+		.group	= FIO_OPT_G_INVALID,
+	},
 #else
 	{
 		.name	= "numa_cpu_nodes",
@@ -4077,6 +4172,12 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.type	= FIO_OPT_UNSUPPORTED,
 		.help	= "Build fio with libnuma-dev(el) to enable this option",
 	},
+	{
+		.name	= "numa_placement",
+		.lname	= "NUMA placement",
+		.type	= FIO_OPT_UNSUPPORTED,
+		.help	= "Build fio with libnuma-dev(el) to enable this option",
+	},
 #endif
 #ifdef CONFIG_CUDA
 	{
@@ -4512,6 +4613,42 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_IO_BUF,
 	},
+	{
+		.name	= "buffer_compress_mode",
+		.lname	= "Buffer compression mode",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, compress_mode),
+		.parent	= "buffer_compress_percentage",
+		.help	= "How compressible buffer contents are generated",
+		.def	= "pad",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IO_BUF,
+		.posval	= {
+			  { .ival = "pad",
+			    .oval = COMPRESS_MODE_PAD,
+			    .help = "Random data followed by zeroes or buffer_pattern",
+			  },
+			  { .ival = "lz",
+			    .oval = COMPRESS_MODE_LZ,
+			    .help = "Random data with repeated strings, for LZ compressors",
+			  },
+			  { .ival = "entropy",
+			    .oval = COMPRESS_MODE_ENTROPY,
+			    .help = "Reduced entropy data with repeated strings, for entropy coding compressors",
+			  },
+		},
+	},
+	{
+		.name	= "buffer_corpus",
+		.lname	= "Buffer corpus size",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, buffer_corpus),
+		.help	= "Copy write buffers from a shared pre-generated corpus of this size",
+		.maxval	= 1U << 31,
+		.def	= "0",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IO_BUF,
+	},
 	{
 		.name	= "dedupe_percentage",
 		.lname	= "Dedupe percentage",
@@ -4559,6 +4696,43 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 		.category = FIO_OPT_C_IO,
 		.group	= FIO_OPT_G_IO_BUF,
 	},
+	{
+		.name	= "dedupe_variant",
+		.lname	= "Dedupe variant",
+		.help	= "How dedupe buffers differ from the buffer they duplicate",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct thread_options, dedupe_variant),
+		.parent	= "dedupe_percentage",
+		.def	= "exact",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IO_BUF,
+		.posval	= {
+			   { .ival = "exact",
+			     .oval = DEDUPE_VARIANT_EXACT,
+			     .help = "exact copy of the original buffer",
+			   },
+			   { .ival = "shifted",
+			     .oval = DEDUPE_VARIANT_SHIFTED,
+			     .help = "original buffer shifted by a random number of sectors",
+			   },
+			   { .ival = "similar",
+			     .oval = DEDUPE_VARIANT_SIMILAR,
+			     .help = "original buffer with dedupe_similar_bits bits flipped",
+			   },
+		},
+	},
+	{
+		.name	= "dedupe_similar_bits",
+		.lname	= "Dedupe similar bits",
+		.help	= "Number of bits flipped in a dedupe_variant=similar buffer",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, dedupe_similar_bits),
+		.parent	= "dedupe_variant",
+		.def	= "8",
+		.minval	= 1,
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IO_BUF,
+	},
 	{
 		.name	= "clat_percentiles",
 		.lname	= "Completion latency percentiles",
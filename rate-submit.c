@@ -247,6 +247,12 @@ static void pthread_double_lock(pthread_mutex_t *lock1, pthread_mutex_t *lock2)
 static void sum_ddir(struct thread_data *dst, struct thread_data *src,
 		     enum fio_ddir ddir)
 {
+	/* workers account a batch at a time, don't lock for an empty one */
+	if (!src->io_bytes[ddir] && !src->io_blocks[ddir] &&
+	    !src->this_io_blocks[ddir] && !src->this_io_bytes[ddir] &&
+	    !src->bytes_done[ddir])
+		return;
+
 	pthread_double_lock(&dst->io_wq.stat_lock, &src->io_wq.stat_lock);
 
 	sum_val(&dst->io_bytes[ddir], &src->io_bytes[ddir]);
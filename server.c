@@ -918,6 +918,8 @@ static int handle_send_eta_cmd(struct fio_net_cmd *cmd)
 
 		je->elapsed_sec		= cpu_to_le64(je->elapsed_sec);
 		je->eta_sec		= cpu_to_le64(je->eta_sec);
+		je->layout_done		= cpu_to_le64(je->layout_done);
+		je->layout_total	= cpu_to_le64(je->layout_total);
 		je->nr_threads		= cpu_to_le32(je->nr_threads);
 		je->is_pow2		= cpu_to_le32(je->is_pow2);
 		je->unit_base		= cpu_to_le32(je->unit_base);
@@ -1,13 +1,21 @@
 /*
  * simple memory allocator, backed by mmap() so that it hands out memory
  * that can be shared across processes and threads
+ *
+ * Small allocations are served from per size class slabs, which are carved
+ * out of the pools. Each size class has SMALLOC_STRIPES free lists with
+ * their own lock, so concurrent jobs rarely meet on the same lock and no
+ * bitmap has to be searched for the common case. Anything larger than the
+ * biggest class goes to the pool bitmaps directly.
  */
 #include <sys/mman.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "fio.h"
 #include "fio_sem.h"
+#include "flist.h"
 #include "os/os.h"
 #include "smalloc.h"
 #include "log.h"
@@ -23,6 +31,10 @@
 
 #define MAX_POOLS	16
 
+#define SMALLOC_NR_CLASSES	32	/* classes of 1..32 blocks */
+#define SMALLOC_STRIPES		8	/* free lists per class */
+#define SMALLOC_SLAB_SIZE	(16 * 1024)
+
 #define SMALLOC_PRE_RED		0xdeadbeefU
 #define SMALLOC_POST_RED	0x5aa55aa5U
 
@@ -46,6 +58,32 @@ struct block_hdr {
 #ifdef SMALLOC_REDZONE
 	unsigned int prered;
 #endif
+	unsigned int slab_off;		/* offset in slab, 0 if not from one */
+};
+
+/*
+ * A slab of equally sized objects. Objects are handed out from the free
+ * list first, then from the never used tail of the slab.
+ */
+struct slab {
+	struct flist_head list;		/* on the stripe list while not full */
+	void *free;			/* freed objects */
+	unsigned int nr_free;
+	unsigned int nr_objs;
+	unsigned int unused;		/* offset of first never used object */
+	unsigned int obj_size;
+	unsigned int pool;
+	unsigned int class;
+	unsigned int stripe;
+};
+
+#define SLAB_HDR_SIZE	\
+	((sizeof(struct slab) + SMALLOC_BPB - 1) & ~(SMALLOC_BPB - 1))
+
+struct slab_stripe {
+	struct fio_sem lock;		/* protects the slabs on this stripe */
+	struct flist_head slabs;	/* slabs with free objects */
+	unsigned int nr_slabs;
 };
 
 /*
@@ -58,6 +96,18 @@ static struct pool *mp;
 static unsigned int nr_pools;
 static unsigned int last_pool;
 
+static struct slab_stripe (*stripes)[SMALLOC_STRIPES];
+
+/*
+ * Stripe used by this thread for its allocations. It's reset on fork, so
+ * that each job picks its own.
+ */
+#ifdef CONFIG_TLS_THREAD
+static __thread int this_stripe = -1;
+#else
+static int this_stripe = -1;
+#endif
+
 static inline int ptr_valid(struct pool *pool, void *ptr)
 {
 	unsigned int pool_size = pool->nr_blocks * SMALLOC_BPL;
@@ -203,6 +253,32 @@ out_fail:
 	return false;
 }
 
+static void smalloc_fork_child(void)
+{
+	this_stripe = -1;
+}
+
+static void sinit_slabs(void)
+{
+	unsigned int i, j;
+
+	stripes = mmap(NULL, SMALLOC_NR_CLASSES * sizeof(*stripes),
+			PROT_READ | PROT_WRITE, OS_MAP_ANON | MAP_SHARED,
+			-1, 0);
+	assert(stripes != MAP_FAILED);
+
+	for (i = 0; i < SMALLOC_NR_CLASSES; i++) {
+		for (j = 0; j < SMALLOC_STRIPES; j++) {
+			struct slab_stripe *st = &stripes[i][j];
+
+			__fio_sem_init(&st->lock, FIO_SEM_UNLOCKED);
+			INIT_FLIST_HEAD(&st->slabs);
+		}
+	}
+
+	pthread_atfork(NULL, NULL, smalloc_fork_child);
+}
+
 void sinit(void)
 {
 	bool ret;
@@ -220,6 +296,8 @@ void sinit(void)
 			OS_MAP_ANON | MAP_SHARED, -1, 0);
 
 		assert(mp != MAP_FAILED);
+
+		sinit_slabs();
 	}
 
 	for (i = 0; i < INITIAL_POOLS; i++) {
@@ -249,7 +327,12 @@ static void cleanup_pool(struct pool *pool)
 
 void scleanup(void)
 {
-	unsigned int i;
+	unsigned int i, j;
+
+	for (i = 0; i < SMALLOC_NR_CLASSES; i++)
+		for (j = 0; j < SMALLOC_STRIPES; j++)
+			__fio_sem_remove(&stripes[i][j].lock);
+	munmap(stripes, SMALLOC_NR_CLASSES * sizeof(*stripes));
 
 	for (i = 0; i < nr_pools; i++)
 		cleanup_pool(&mp[i]);
@@ -303,12 +386,57 @@ static void sfree_check_redzone(struct block_hdr *hdr)
 }
 #endif
 
-static void sfree_pool(struct pool *pool, void *ptr)
+static void free_pool_blocks(struct pool *pool, void *ptr, size_t size)
 {
-	struct block_hdr *hdr;
 	unsigned int i, idx;
 	unsigned long offset;
 
+	offset = ptr - pool->map;
+	i = offset / SMALLOC_BPL;
+	idx = (offset % SMALLOC_BPL) / SMALLOC_BPB;
+
+	fio_sem_down(pool->lock);
+	clear_blocks(pool, i, idx, size_to_blocks(size));
+	if (i < pool->next_non_full)
+		pool->next_non_full = i;
+	pool->free_blocks += size_to_blocks(size);
+	fio_sem_up(pool->lock);
+}
+
+static void sfree_slab(struct slab *slab, struct block_hdr *hdr)
+{
+	struct slab_stripe *st = &stripes[slab->class][slab->stripe];
+	bool release = false;
+
+#ifdef SMALLOC_REDZONE
+	/* catch a double free on the next sfree_check_redzone() */
+	hdr->prered = 0;
+#endif
+	fio_sem_down(&st->lock);
+
+	*(void **) (hdr + 1) = slab->free;
+	slab->free = hdr;
+	if (!slab->nr_free++)
+		flist_add(&slab->list, &st->slabs);
+
+	/* keep one empty slab around, give the others back to the pool */
+	if (slab->nr_free == slab->nr_objs &&
+	    st->slabs.next != st->slabs.prev) {
+		flist_del(&slab->list);
+		st->nr_slabs--;
+		release = true;
+	}
+
+	fio_sem_up(&st->lock);
+
+	if (release)
+		free_pool_blocks(&mp[slab->pool], slab, SMALLOC_SLAB_SIZE);
+}
+
+static void sfree_pool(struct pool *pool, void *ptr)
+{
+	struct block_hdr *hdr;
+
 	if (!ptr)
 		return;
 
@@ -319,16 +447,10 @@ static void sfree_pool(struct pool *pool, void *ptr)
 
 	sfree_check_redzone(hdr);
 
-	offset = ptr - pool->map;
-	i = offset / SMALLOC_BPL;
-	idx = (offset % SMALLOC_BPL) / SMALLOC_BPB;
-
-	fio_sem_down(pool->lock);
-	clear_blocks(pool, i, idx, size_to_blocks(hdr->size));
-	if (i < pool->next_non_full)
-		pool->next_non_full = i;
-	pool->free_blocks += size_to_blocks(hdr->size);
-	fio_sem_up(pool->lock);
+	if (hdr->slab_off)
+		sfree_slab(ptr - hdr->slab_off, hdr);
+	else
+		free_pool_blocks(pool, ptr, hdr->size);
 }
 
 void sfree(void *ptr)
@@ -445,23 +567,103 @@ static size_t size_to_alloc_size(size_t size)
 	return alloc_size;
 }
 
+static void *init_block(void *ptr, size_t size, size_t alloc_size,
+			unsigned int slab_off)
+{
+	struct block_hdr *hdr = ptr;
+
+	hdr->size = alloc_size;
+	hdr->slab_off = slab_off;
+	fill_redzone(hdr);
+
+	ptr += sizeof(*hdr);
+	memset(ptr, 0, size);
+	return ptr;
+}
+
 static void *smalloc_pool(struct pool *pool, size_t size)
 {
 	size_t alloc_size = size_to_alloc_size(size);
 	void *ptr;
 
 	ptr = __smalloc_pool(pool, alloc_size);
-	if (ptr) {
-		struct block_hdr *hdr = ptr;
+	if (ptr)
+		ptr = init_block(ptr, size, alloc_size, 0);
 
-		hdr->size = alloc_size;
-		fill_redzone(hdr);
+	return ptr;
+}
 
-		ptr += sizeof(*hdr);
-		memset(ptr, 0, size);
+static struct slab *new_slab(unsigned int class, unsigned int stripe)
+{
+	unsigned int i = last_pool, j;
+	struct slab *slab = NULL;
+
+	for (j = 0; j < nr_pools; j++, i = (i + 1) % nr_pools) {
+		slab = __smalloc_pool(&mp[i], SMALLOC_SLAB_SIZE);
+		if (slab)
+			break;
 	}
+	if (!slab)
+		return NULL;
 
-	return ptr;
+	slab->free = NULL;
+	slab->obj_size = (class + 1) * SMALLOC_BPB;
+	slab->nr_objs = (SMALLOC_SLAB_SIZE - SLAB_HDR_SIZE) / slab->obj_size;
+	slab->nr_free = slab->nr_objs;
+	slab->unused = SLAB_HDR_SIZE;
+	slab->pool = i;
+	slab->class = class;
+	slab->stripe = stripe;
+	return slab;
+}
+
+static unsigned int get_stripe(void)
+{
+	if (this_stripe < 0)
+		this_stripe = gettid() % SMALLOC_STRIPES;
+
+	return this_stripe;
+}
+
+/*
+ * Allocate from the slabs of the class fitting 'alloc_size'. Returns NULL
+ * if no new slab could be carved out of the pools, the caller then falls
+ * back to the pool bitmaps.
+ */
+static void *smalloc_slab(size_t size, size_t alloc_size)
+{
+	unsigned int class = size_to_blocks(alloc_size) - 1;
+	unsigned int stripe = get_stripe();
+	struct slab_stripe *st = &stripes[class][stripe];
+	struct slab *slab;
+	void *ptr;
+
+	fio_sem_down(&st->lock);
+
+	if (flist_empty(&st->slabs)) {
+		slab = new_slab(class, stripe);
+		if (!slab) {
+			fio_sem_up(&st->lock);
+			return NULL;
+		}
+		flist_add(&slab->list, &st->slabs);
+		st->nr_slabs++;
+	} else
+		slab = flist_first_entry(&st->slabs, struct slab, list);
+
+	if (slab->free) {
+		ptr = slab->free;
+		slab->free = *(void **) ((struct block_hdr *) ptr + 1);
+	} else {
+		ptr = (void *) slab + slab->unused;
+		slab->unused += slab->obj_size;
+	}
+	if (!--slab->nr_free)
+		flist_del(&slab->list);
+
+	fio_sem_up(&st->lock);
+
+	return init_block(ptr, size, alloc_size, ptr - (void *) slab);
 }
 
 static void smalloc_print_bitmap(struct pool *pool)
@@ -528,15 +730,33 @@ void smalloc_debug(size_t size)
 			}
 		}
 	}
+	for (i = 0; i < SMALLOC_NR_CLASSES; i++) {
+		unsigned int j, nr_slabs = 0;
+
+		for (j = 0; j < SMALLOC_STRIPES; j++)
+			nr_slabs += stripes[i][j].nr_slabs;
+		if (nr_slabs)
+			log_err("smalloc: class %u bytes, %u slabs\n",
+				(i + 1) * SMALLOC_BPB, nr_slabs);
+	}
 }
 
 void *smalloc(size_t size)
 {
 	unsigned int i, end_pool;
+	size_t alloc_size;
 
 	if (size != (unsigned int) size)
 		return NULL;
 
+	alloc_size = size_to_alloc_size(size);
+	if (size_to_blocks(alloc_size) <= SMALLOC_NR_CLASSES) {
+		void *ptr = smalloc_slab(size, alloc_size);
+
+		if (ptr)
+			return ptr;
+	}
+
 	i = last_pool;
 	end_pool = nr_pools;
 
@@ -287,6 +287,8 @@ struct thread_stat {
 	uint32_t pad;							\
 	uint64_t elapsed_sec;						\
 	uint64_t eta_sec;						\
+	uint64_t layout_done;						\
+	uint64_t layout_total;						\
 	uint32_t is_pow2;						\
 	uint32_t unit_base;						\
 									\
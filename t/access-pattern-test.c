@@ -0,0 +1,148 @@
+/*
+ * Check parsing of random_pattern specs and the shape of the generated
+ * offsets: skew, windows, drift, growth and duty cycles.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lib/access_pattern.h"
+
+#define NRANGES		100000
+#define NR_SAMPLES	200000
+#define NR_BUCKETS	10
+
+static int errors;
+
+#define check(cond, ...)						\
+	do {								\
+		if (!(cond)) {						\
+			fprintf(stderr, __VA_ARGS__);			\
+			errors++;					\
+		}							\
+	} while (0)
+
+static const char *bad_specs[] = {
+	"",
+	"bogus",
+	"50%zipf + 60%uniform",
+	"50%zipf + 50%scan + uniform",
+	"80%zipf",
+	"zipf:-1",
+	"pareto:1.5",
+	"uniform:3",
+	"zipf/size=0%",
+	"zipf/speed=3",
+	"scan/every=1s",
+	"scan/every=1s/for=2s",
+	"zipf junk",
+};
+
+static struct access_pattern *compile(const char *spec)
+{
+	struct access_pattern *ap;
+	const char *err;
+
+	ap = apat_parse(spec, &err);
+	if (!ap) {
+		fprintf(stderr, "%s: %s\n", spec, err);
+		exit(1);
+	}
+	if (!apat_compile(ap, NRANGES)) {
+		fprintf(stderr, "%s: compile failed\n", spec);
+		exit(1);
+	}
+	return ap;
+}
+
+/*
+ * Fill 'hist' with the share of samples per tenth of the file at 'msec'
+ */
+static void sample(const char *spec, uint64_t msec, double *hist)
+{
+	struct access_pattern *ap = compile(spec);
+	struct apat_state s;
+	unsigned int i;
+
+	apat_state_init(&s, 1234);
+	memset(hist, 0, NR_BUCKETS * sizeof(double));
+
+	for (i = 0; i < NR_SAMPLES; i++) {
+		uint64_t b = apat_next(ap, &s, msec, NRANGES);
+
+		if (b >= NRANGES) {
+			check(0, "%s: block %llu out of range\n", spec,
+				(unsigned long long) b);
+			break;
+		}
+		hist[b * NR_BUCKETS / NRANGES] += 1.0 / NR_SAMPLES;
+	}
+
+	apat_free(ap);
+}
+
+int main(int argc, char *argv[])
+{
+	double h[NR_BUCKETS];
+	struct access_pattern *ap;
+	const char *err;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(bad_specs) / sizeof(bad_specs[0]); i++) {
+		ap = apat_parse(bad_specs[i], &err);
+		check(!ap, "'%s' should not parse\n", bad_specs[i]);
+		apat_free(ap);
+	}
+
+	ap = compile(" 20% zipf:1.2 / size=5% + scan + normal:5/start=50% ");
+	check(ap->nr_terms == 3, "expected 3 terms\n");
+	check(ap->terms[1].weight > 0.399 && ap->terms[1].weight < 0.401,
+		"unweighted terms should split the rest\n");
+	check(!ap->timed, "static pattern marked as timed\n");
+	apat_free(ap);
+
+	sample("uniform", 0, h);
+	for (i = 0; i < NR_BUCKETS; i++)
+		check(h[i] > 0.09 && h[i] < 0.11, "uniform: bucket %u %f\n", i, h[i]);
+
+	sample("zipf:1.2/size=10%", 0, h);
+	check(h[0] > 0.99, "zipf: window not honoured %f\n", h[0]);
+
+	sample("pareto:0.2/start=30%/size=10%", 0, h);
+	check(h[3] > 0.99, "pareto: window not honoured %f\n", h[3]);
+
+	sample("normal:5/start=40%/size=20%", 0, h);
+	check(h[4] > 0.45 && h[5] > 0.45, "normal: not centered %f %f\n",
+		h[4], h[5]);
+
+	sample("50%uniform/size=10% + 50%scan/start=90%/size=10%", 0, h);
+	check(h[0] > 0.48 && h[0] < 0.52 && h[9] > 0.48 && h[9] < 0.52,
+		"weights: %f %f\n", h[0], h[9]);
+
+	sample("uniform/size=10%/drift=10s", 5000, h);
+	check(h[5] > 0.99, "drift: window at 5s %f\n", h[5]);
+	sample("uniform/size=10%/start=95%", 0, h);
+	check(h[9] > 0.45 && h[0] > 0.45, "window should wrap %f %f\n",
+		h[9], h[0]);
+
+	sample("uniform/size=10%/grow=10s", 5000, h);
+	for (i = 0; i < 5; i++)
+		check(h[i] > 0.17 && h[i] < 0.19, "grow: bucket %u %f\n", i, h[i]);
+	check(h[5] > 0.08 && h[5] < 0.10 && h[6] < 0.01,
+		"grow: window at 5s %f %f\n", h[5], h[6]);
+
+	sample("50%uniform/size=10% + 50%uniform/start=90%/size=10%/every=1s/for=100ms",
+		1500, h);
+	check(h[0] > 0.99, "duty cycle: inactive term used %f\n", h[0]);
+	sample("50%uniform/size=10% + 50%uniform/start=90%/size=10%/every=1s/for=100ms",
+		2050, h);
+	check(h[9] > 0.48, "duty cycle: active term not used %f\n", h[9]);
+
+	if (errors) {
+		fprintf(stderr, "%d access pattern checks failed\n", errors);
+		return 1;
+	}
+
+	printf("access pattern checks passed\n");
+	return 0;
+}
@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "../lib/lfsr.h"
 #include "../lib/axmap.h"
@@ -393,11 +396,192 @@ static int test_overlap(void)
 	return err;
 }
 
+static uint64_t nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Mark the whole map in random order, @nr bits at a time, like
+ * mark_random_map() does for I/Os of @nr blocks.
+ */
+static int bench_set(uint64_t size, unsigned int nr)
+{
+	uint64_t slots = size / nr, val, start, nsec, i;
+	struct fio_lfsr lfsr;
+	struct axmap *map;
+
+	map = axmap_new(slots * nr);
+	lfsr_init(&lfsr, slots, 1, 0);
+
+	start = nsec_now();
+	for (i = 0; i < slots; i++) {
+		if (lfsr_next(&lfsr, &val))
+			break;
+		if (axmap_set_nr(map, val * nr, nr) != nr) {
+			printf("set_nr: short set\n");
+			axmap_free(map);
+			return 1;
+		}
+	}
+	nsec = nsec_now() - start;
+
+	printf("  set_nr(%3u)   %8.2f Mops/s  %8.2f Gbits/s\n", nr,
+		(double) slots * 1000.0 / nsec, (double) slots * nr / nsec);
+	axmap_free(map);
+	return 0;
+}
+
+/*
+ * Fill the map to @perc percent in random order, then look for the next
+ * free bit from random positions.
+ */
+static int bench_next_free(uint64_t size, unsigned int perc)
+{
+	uint64_t nr_set = size * perc / 100, val, start, nsec, i, loops;
+	struct fio_lfsr lfsr;
+	struct axmap *map;
+
+	map = axmap_new(size);
+	lfsr_init(&lfsr, size, 1, 0);
+	for (i = 0; i < nr_set; i++) {
+		if (lfsr_next(&lfsr, &val))
+			break;
+		axmap_set(map, val);
+	}
+
+	loops = 1000000;
+	val = 0x8989;
+	start = nsec_now();
+	for (i = 0; i < loops; i++) {
+		val ^= val << 13;
+		val ^= val >> 7;
+		val ^= val << 17;
+		if (axmap_next_free(map, val % size) == -1ULL) {
+			printf("next_free: no free bit\n");
+			axmap_free(map);
+			return 1;
+		}
+	}
+	nsec = nsec_now() - start;
+
+	printf("  next_free(%u%% full)  %8.2f Mops/s\n", perc,
+		(double) loops * 1000.0 / nsec);
+	axmap_free(map);
+	return 0;
+}
+
+struct shared_worker {
+	pthread_t thread;
+	struct axmap *map;
+	uint64_t slots;
+	unsigned int nr;
+	unsigned int seed;
+	uint64_t claimed;
+};
+
+static void *shared_fn(void *data)
+{
+	struct shared_worker *w = data;
+	struct fio_lfsr lfsr;
+	uint64_t i, val;
+
+	lfsr_init(&lfsr, w->slots, w->seed, w->seed & 0xF);
+	for (i = 0; i < w->slots; i++) {
+		if (lfsr_next(&lfsr, &val))
+			break;
+		w->claimed += axmap_set_nr(w->map, val * w->nr, w->nr);
+	}
+
+	return NULL;
+}
+
+/*
+ * Have @nr_threads workers claim blocks of a shared map, each in its own
+ * random order. Every bit must be claimed exactly once.
+ */
+static int bench_shared(uint64_t size, unsigned int nr_threads)
+{
+	const unsigned int nr = 8;
+	uint64_t slots = size / nr, claimed = 0, start, nsec;
+	struct shared_worker *workers;
+	struct axmap *map;
+	unsigned int i;
+	int err = 0;
+
+	map = axmap_new_shared(slots * nr, malloc, free);
+	workers = calloc(nr_threads, sizeof(*workers));
+
+	start = nsec_now();
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].map = map;
+		workers[i].slots = slots;
+		workers[i].nr = nr;
+		workers[i].seed = i + 1;
+		pthread_create(&workers[i].thread, NULL, shared_fn, &workers[i]);
+	}
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		claimed += workers[i].claimed;
+	}
+	nsec = nsec_now() - start;
+
+	if (claimed != slots * nr ||
+	    axmap_next_free(map, 0) != -1ULL) {
+		printf("shared: claimed %llu of %llu bits\n",
+			(unsigned long long) claimed,
+			(unsigned long long) slots * nr);
+		err = 1;
+	} else
+		printf("  shared(%2u jobs)  %8.2f Mops/s, each bit claimed once\n",
+			nr_threads, (double) slots * nr_threads * 1000.0 / nsec);
+
+	free(workers);
+	axmap_free(map);
+	return err;
+}
+
+static int run_bench(uint64_t size, unsigned int nr_threads)
+{
+	unsigned int nrs[] = { 1, 8, 64, 256, 0 };
+	unsigned int i;
+
+	printf("Benchmark with %llu entries\n", (unsigned long long) size);
+
+	for (i = 0; nrs[i]; i++)
+		if (bench_set(size, nrs[i]))
+			return 1;
+
+	if (bench_next_free(size, 50) || bench_next_free(size, 99))
+		return 1;
+
+	for (i = 1; i <= nr_threads; i *= 2)
+		if (bench_shared(size, i))
+			return 1;
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	uint64_t size = (1ULL << 23) - 200;
 	int seed = 1;
 
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		unsigned int nr_threads = 4;
+
+		size = 1ULL << 26;
+		if (argc > 2)
+			size = strtoull(argv[2], NULL, 10);
+		if (argc > 3)
+			nr_threads = strtoul(argv[3], NULL, 10);
+
+		return run_bench(size, nr_threads);
+	}
+
 	if (argc > 1) {
 		size = strtoul(argv[1], NULL, 10);
 		if (argc > 2)
@@ -75,6 +75,8 @@ static unsigned int collision_check;
 static unsigned int print_progress = 1;
 static unsigned int use_bloom = 1;
 static unsigned int compression = 0;
+static unsigned int cdc_avg;
+static unsigned int similarity;
 
 static uint64_t total_size;
 static uint64_t cur_offset;
@@ -616,6 +618,275 @@ static void iter_rb_tree(uint64_t *nextents, uint64_t *nchunks, uint64_t *ndupex
 	} while ((n = rb_next(n)) != NULL);
 }
 
+/*
+ * Open addressing set of 64-bit hashes, used by the sequential variable
+ * chunk and similarity passes. Zero marks an empty slot.
+ */
+struct hash_set {
+	uint64_t *slots;
+	uint64_t mask;
+};
+
+static int hash_set_init(struct hash_set *hs, uint64_t entries)
+{
+	uint64_t nr = 1024;
+
+	while (nr < 2 * entries)
+		nr <<= 1;
+
+	hs->slots = calloc(nr, sizeof(uint64_t));
+	hs->mask = nr - 1;
+	return hs->slots == NULL;
+}
+
+static void hash_set_free(struct hash_set *hs)
+{
+	free(hs->slots);
+}
+
+/*
+ * Returns true if 'key' was already in the set, otherwise adds it.
+ */
+static bool hash_set_add(struct hash_set *hs, uint64_t key)
+{
+	uint64_t i;
+
+	if (!key)
+		key = 1;
+
+	i = key & hs->mask;
+	while (hs->slots[i]) {
+		if (hs->slots[i] == key)
+			return true;
+		i = (i + 1) & hs->mask;
+	}
+
+	hs->slots[i] = key;
+	return false;
+}
+
+static uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static uint64_t md5_key(void *buf, unsigned int len)
+{
+	uint32_t hash[MD5_HASH_WORDS];
+	struct fio_md5_ctx ctx = { .hash = hash };
+
+	fio_md5_init(&ctx);
+	fio_md5_update(&ctx, buf, len);
+	fio_md5_final(&ctx);
+	return ((uint64_t) hash[0] << 32) | hash[1];
+}
+
+/*
+ * Content defined chunking with a gear rolling hash, like FastCDC. Chunk
+ * boundaries depend on the data rather than the offset, so data that has
+ * been shifted by less than a block is still found to be duplicate.
+ */
+static uint64_t gear[256];
+
+static unsigned int cdc_next(const uint8_t *p, unsigned int len,
+			     unsigned int min_size, unsigned int max_size,
+			     uint64_t mask)
+{
+	uint64_t h = 0;
+	unsigned int i;
+
+	if (len <= min_size)
+		return len;
+	if (len > max_size)
+		len = max_size;
+
+	for (i = min_size; i < len; i++) {
+		h = (h << 1) + gear[p[i]];
+		if (!(h & mask))
+			return i + 1;
+	}
+
+	return len;
+}
+
+static int cdc_check(int fd, uint64_t dev_size)
+{
+	unsigned int min_size, max_size, carry_size, left = 0;
+	uint64_t offset = 0, nchunks = 0, dup_bytes = 0, mask, avg;
+	struct hash_set hs;
+	uint8_t *buf, *data;
+	int i, ret = 0;
+
+	for (i = 0; i < 256; i++)
+		gear[i] = mix64(i + 1);
+
+	avg = 64;
+	while (avg * 2 <= cdc_avg)
+		avg <<= 1;
+	/* the high bits of the gear hash see the most bytes */
+	mask = (avg - 1) << (64 - __builtin_ctzll(avg));
+	min_size = avg / 4;
+	max_size = avg * 4;
+
+	carry_size = (max_size + blocksize - 1) / blocksize * blocksize;
+	buf = fio_memalign(blocksize, carry_size + chunk_size, false);
+	if (hash_set_init(&hs, dev_size / min_size)) {
+		log_err("dedupe: failed allocating hash set\n");
+		fio_memfree(buf, carry_size + chunk_size, false);
+		return 1;
+	}
+
+	while (offset < dev_size || left) {
+		unsigned int this_len = 0, len, pos = 0;
+
+		if (offset < dev_size) {
+			this_len = min((uint64_t) chunk_size, dev_size - offset);
+			if (__read_block(fd, buf + carry_size, offset, this_len)) {
+				ret = 1;
+				break;
+			}
+			offset += this_len;
+		}
+
+		data = buf + carry_size - left;
+		len = left + this_len;
+
+		/*
+		 * Leave the tail for the next read, unless this is the end of
+		 * the file, as it may be the start of a longer chunk.
+		 */
+		while (pos < len) {
+			unsigned int clen;
+
+			if (offset < dev_size && len - pos < max_size)
+				break;
+
+			clen = cdc_next(data + pos, len - pos, min_size,
+					max_size, mask);
+			if (hash_set_add(&hs, md5_key(data + pos, clen)))
+				dup_bytes += clen;
+			nchunks++;
+			pos += clen;
+		}
+
+		left = len - pos;
+		memmove(buf + carry_size - left, data + pos, left);
+	}
+
+	if (!ret) {
+		printf("Variable chunks (avg %llu): %llu, duplicate data %3.2f%%\n",
+			(unsigned long long) avg, (unsigned long long) nchunks,
+			100.0 * (double) dup_bytes / (double) dev_size);
+	}
+
+	hash_set_free(&hs);
+	fio_memfree(buf, carry_size + chunk_size, false);
+	return ret;
+}
+
+/*
+ * Resemblance detection: blocks that share a super feature are likely
+ * near duplicates, and could be stored as a delta against each other.
+ * Each feature is the maximum of a different hash of all 8 byte windows in
+ * the block, and each super feature hashes a group of features.
+ */
+#define NR_FEATURES	12
+#define NR_SUPER	3
+#define FEAT_PER_SUPER	(NR_FEATURES / NR_SUPER)
+
+static void block_super_features(const uint8_t *p, uint64_t *sf)
+{
+	uint64_t feat[NR_FEATURES] = { 0 };
+	unsigned int i, j;
+
+	for (i = 0; i + 8 <= blocksize; i++) {
+		uint64_t w;
+
+		memcpy(&w, p + i, sizeof(w));
+		w = mix64(w);
+		for (j = 0; j < NR_FEATURES; j++) {
+			uint64_t v = w * (2 * j + 1) + j * 0x9e3779b97f4a7c15ULL;
+
+			v ^= v >> 31;
+			if (v > feat[j])
+				feat[j] = v;
+		}
+	}
+
+	for (i = 0; i < NR_SUPER; i++) {
+		uint64_t h = i + 1;
+
+		for (j = 0; j < FEAT_PER_SUPER; j++)
+			h = mix64(h ^ feat[i * FEAT_PER_SUPER + j]);
+		sf[i] = h;
+	}
+}
+
+static int similarity_check(int fd, uint64_t dev_size)
+{
+	uint64_t offset = 0, nblocks = 0, nexact = 0, nsimilar = 0;
+	struct hash_set exact = { 0 }, sfs = { 0 };
+	uint8_t *buf;
+	int ret = 0;
+
+	buf = fio_memalign(blocksize, chunk_size, false);
+	if (hash_set_init(&exact, dev_size / blocksize) ||
+	    hash_set_init(&sfs, NR_SUPER * (dev_size / blocksize))) {
+		log_err("dedupe: failed allocating hash set\n");
+		ret = 1;
+		goto out;
+	}
+
+	while (offset < dev_size) {
+		unsigned int i, this_len;
+
+		this_len = min((uint64_t) chunk_size, dev_size - offset);
+		if (__read_block(fd, buf, offset, this_len)) {
+			ret = 1;
+			break;
+		}
+		offset += this_len;
+
+		for (i = 0; i < this_len; i += blocksize) {
+			uint64_t sf[NR_SUPER];
+			bool similar = false;
+			int j;
+
+			nblocks++;
+			if (hash_set_add(&exact, md5_key(buf + i, blocksize))) {
+				nexact++;
+				continue;
+			}
+
+			block_super_features(buf + i, sf);
+			for (j = 0; j < NR_SUPER; j++)
+				similar |= hash_set_add(&sfs, sf[j]);
+			nsimilar += similar;
+		}
+	}
+
+	if (!ret && nblocks) {
+		printf("Blocks=%llu, exact duplicates=%llu (%3.2f%%), "
+			"similar=%llu (%3.2f%%)\n",
+			(unsigned long long) nblocks,
+			(unsigned long long) nexact,
+			100.0 * (double) nexact / (double) nblocks,
+			(unsigned long long) nsimilar,
+			100.0 * (double) nsimilar / (double) nblocks);
+	}
+
+out:
+	hash_set_free(&exact);
+	hash_set_free(&sfs);
+	fio_memfree(buf, chunk_size, false);
+	return ret;
+}
+
 static int usage(char *argv[])
 {
 	log_err("Check for dedupable blocks on a device/file\n\n");
@@ -628,6 +899,8 @@ static int usage(char *argv[])
 	log_err("\t-B\tUse probabilistic bloom filter\n");
 	log_err("\t-p\tPrint progress indicator\n");
 	log_err("\t-C\tCalculate compressible size\n");
+	log_err("\t-V\tVariable size chunking, with this average size\n");
+	log_err("\t-S\tCount similar (near duplicate) blocks\n");
 	return 1;
 }
 
@@ -639,7 +912,7 @@ int main(int argc, char *argv[])
 	arch_init(argv);
 	debug_init();
 
-	while ((c = getopt(argc, argv, "b:t:d:o:c:p:B:C:")) != -1) {
+	while ((c = getopt(argc, argv, "b:t:d:o:c:p:B:C:V:S:")) != -1) {
 		switch (c) {
 		case 'b':
 			blocksize = atoi(optarg);
@@ -665,6 +938,12 @@ int main(int argc, char *argv[])
 		case 'C':
 			compression = atoi(optarg);
 			break;
+		case 'V':
+			cdc_avg = atoi(optarg);
+			break;
+		case 'S':
+			similarity = atoi(optarg);
+			break;
 		case '?':
 		default:
 			return usage(argv);
@@ -692,6 +971,11 @@ int main(int argc, char *argv[])
 			iter_rb_tree(&nextents, &nchunks, &ndupextents);
 
 		show_stat(nextents, nchunks, ndupextents, unique_capacity);
+
+		if (cdc_avg)
+			ret |= cdc_check(file.fd, total_size);
+		if (similarity)
+			ret |= similarity_check(file.fd, total_size);
 	}
 
 	fio_sem_remove(rb_lock);
@@ -0,0 +1,134 @@
+/*
+ * Check that the feistel generator is a permutation of its range, also
+ * when split between several walkers, and compare its speed to the LFSR.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../lib/feistel.h"
+#include "../lib/lfsr.h"
+
+static uint64_t nsec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Walk a permutation of @nr values split between @parts walkers, and
+ * check that every value is generated exactly once.
+ */
+static int check_permutation(uint64_t nr, unsigned int parts, uint64_t seed)
+{
+	unsigned char *seen;
+	uint64_t i, val, total = 0;
+	unsigned int p;
+	int err = 0;
+
+	printf("Checking %llu values, %u part(s)...",
+		(unsigned long long) nr, parts);
+	fflush(stdout);
+
+	seen = calloc(nr, 1);
+	if (!seen) {
+		perror("calloc");
+		return 1;
+	}
+
+	for (p = 0; p < parts && !err; p++) {
+		uint64_t share = nr / parts, extra = nr % parts;
+		uint64_t start = share * p + (p < extra ? p : extra);
+		uint64_t end = start + share + (p < extra);
+		struct fio_feistel fp;
+
+		if (feistel_init(&fp, nr, seed, start, end)) {
+			printf("init failed\n");
+			err = 1;
+			break;
+		}
+
+		while (!feistel_next(&fp, &val)) {
+			if (val >= nr || seen[val]) {
+				printf("bad value %llu\n",
+					(unsigned long long) val);
+				err = 1;
+				break;
+			}
+			seen[val] = 1;
+			total++;
+		}
+	}
+
+	for (i = 0; !err && i < nr; i++) {
+		if (!seen[i]) {
+			printf("value %llu never generated\n",
+				(unsigned long long) i);
+			err = 1;
+		}
+	}
+
+	if (!err && total != nr) {
+		printf("generated %llu values\n", (unsigned long long) total);
+		err = 1;
+	}
+
+	if (!err)
+		printf("pass!\n");
+
+	free(seen);
+	return err;
+}
+
+static void bench(uint64_t nr)
+{
+	struct fio_feistel fp;
+	struct fio_lfsr fl;
+	uint64_t start, nsec, val, sum = 0;
+
+	feistel_init(&fp, nr, 0x8989, 0, nr);
+	start = nsec_now();
+	while (!feistel_next(&fp, &val))
+		sum += val;
+	nsec = nsec_now() - start;
+	printf("feistel: %8.2f Mvals/s\n", (double) nr * 1000.0 / nsec);
+
+	lfsr_init(&fl, nr, 0x8989, 0);
+	start = nsec_now();
+	while (!lfsr_next(&fl, &val))
+		sum += val;
+	nsec = nsec_now() - start;
+	printf("lfsr:    %8.2f Mvals/s\n", (double) nr * 1000.0 / nsec);
+
+	if (sum != nr * (nr - 1))
+		printf("checksum mismatch\n");
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t sizes[] = { 1, 2, 3, 17, 1000, 65536, 1000003, 0 };
+	int i;
+
+	if (argc > 1) {
+		uint64_t nr = strtoull(argv[1], NULL, 0);
+
+		if (!nr) {
+			printf("Usage: feistel-test [values]\n");
+			return 1;
+		}
+		bench(nr);
+		return 0;
+	}
+
+	for (i = 0; sizes[i]; i++) {
+		if (check_permutation(sizes[i], 1, i))
+			return 1;
+		if (check_permutation(sizes[i], 7, i))
+			return 1;
+	}
+
+	return 0;
+}
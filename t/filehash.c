@@ -0,0 +1,224 @@
+/*
+ * Measure insert, lookup and remove rates of the shared file hash
+ * (filehash.c) as the number of concurrent jobs grows. Each job owns its
+ * own set of files, and also looks up files owned by the other jobs, like
+ * jobs sharing a directory of files would. With -l, every hash operation
+ * is additionally serialized through one global lock, which is what the
+ * hash looked like before it was striped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../fio.h"
+#include "../filehash.h"
+#include "../smalloc.h"
+#include "../gettime.h"
+#include "../fio_time.h"
+
+#define DEF_FILES	65536
+#define DEF_LOOKUPS	4
+#define DEF_MAX_JOBS	8
+
+struct worker {
+	pthread_t thread;
+	unsigned int index;
+	unsigned int nr_jobs;
+	struct fio_file *files;
+	unsigned long errors;
+};
+
+static struct worker *workers;
+static unsigned int nr_files = DEF_FILES;
+static unsigned int nr_lookups = DEF_LOOKUPS;
+static bool global_lock;
+static pthread_mutex_t big_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_barrier_t barrier;
+
+static void op_lock(void)
+{
+	if (global_lock)
+		pthread_mutex_lock(&big_lock);
+}
+
+static void op_unlock(void)
+{
+	if (global_lock)
+		pthread_mutex_unlock(&big_lock);
+}
+
+static void *thread_fn(void *data)
+{
+	struct worker *w = data;
+	unsigned int i, j;
+
+	pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < nr_files; i++) {
+		op_lock();
+		if (add_file_hash(&w->files[i]))
+			w->errors++;
+		op_unlock();
+	}
+
+	pthread_barrier_wait(&barrier);
+
+	for (j = 0; j < nr_lookups; j++) {
+		struct worker *other = &workers[(w->index + j) % w->nr_jobs];
+
+		for (i = 0; i < nr_files; i++) {
+			struct fio_file *f = &other->files[i];
+
+			op_lock();
+			if (lookup_file_hash(f->file_name) != f)
+				w->errors++;
+			op_unlock();
+		}
+	}
+
+	pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < nr_files; i++) {
+		op_lock();
+		remove_file_hash(&w->files[i]);
+		op_unlock();
+	}
+
+	pthread_barrier_wait(&barrier);
+	return NULL;
+}
+
+static double mops(uint64_t ops, uint64_t usec)
+{
+	if (!usec)
+		usec = 1;
+
+	return (double) ops / (double) usec;
+}
+
+static int run_jobs(unsigned int nr_jobs)
+{
+	uint64_t usec[3], ops;
+	struct timespec start;
+	unsigned long errors = 0;
+	unsigned int i;
+	int phase;
+
+	pthread_barrier_init(&barrier, NULL, nr_jobs + 1);
+
+	for (i = 0; i < nr_jobs; i++) {
+		workers[i].index = i;
+		workers[i].nr_jobs = nr_jobs;
+		workers[i].errors = 0;
+		if (pthread_create(&workers[i].thread, NULL, thread_fn, &workers[i])) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+
+	/*
+	 * Each phase starts when all workers reach the barrier, and ends when
+	 * the last of them gets to the next one.
+	 */
+	pthread_barrier_wait(&barrier);
+	for (phase = 0; phase < 3; phase++) {
+		fio_gettime(&start, NULL);
+		pthread_barrier_wait(&barrier);
+		usec[phase] = utime_since_now(&start);
+	}
+
+	for (i = 0; i < nr_jobs; i++) {
+		pthread_join(workers[i].thread, NULL);
+		errors += workers[i].errors;
+	}
+
+	pthread_barrier_destroy(&barrier);
+
+	ops = (uint64_t) nr_jobs * nr_files;
+	printf("%4u  %12.2f  %12.2f  %12.2f\n", nr_jobs,
+		mops(ops, usec[0]), mops(ops * nr_lookups, usec[1]),
+		mops(ops, usec[2]));
+
+	if (errors) {
+		printf("%lu hash errors\n", errors);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void usage(void)
+{
+	printf("Usage: fio-filehash [-f files] [-j max jobs] [-n lookups] [-l]\n");
+	printf("\t-f\tFiles per job (default %u)\n", DEF_FILES);
+	printf("\t-j\tRun with 1, 2, 4, ... up to this many jobs (default %u)\n",
+		DEF_MAX_JOBS);
+	printf("\t-n\tLookup passes per job (default %u)\n", DEF_LOOKUPS);
+	printf("\t-l\tSerialize all hash operations on a global lock\n");
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int max_jobs = DEF_MAX_JOBS, nr_jobs, i, j;
+	int c, ret = 0;
+
+	while ((c = getopt(argc, argv, "f:j:n:lh")) != -1) {
+		switch (c) {
+		case 'f':
+			nr_files = atoi(optarg);
+			break;
+		case 'j':
+			max_jobs = atoi(optarg);
+			break;
+		case 'n':
+			nr_lookups = atoi(optarg);
+			break;
+		case 'l':
+			global_lock = true;
+			break;
+		case 'h':
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	if (!nr_files || !max_jobs) {
+		usage();
+		return 1;
+	}
+
+	sinit();
+	file_hash_init();
+
+	workers = calloc(max_jobs, sizeof(*workers));
+	for (i = 0; i < max_jobs; i++) {
+		workers[i].files = calloc(nr_files, sizeof(struct fio_file));
+		for (j = 0; j < nr_files; j++) {
+			char name[64];
+
+			snprintf(name, sizeof(name), "/mnt/fio/job%u.%u", i, j);
+			workers[i].files[j].file_name = strdup(name);
+		}
+	}
+
+	printf("%u files per job, %s\n", nr_files,
+		global_lock ? "global lock" : "striped locks");
+	printf("jobs  insert Mop/s  lookup Mop/s  remove Mop/s\n");
+
+	for (nr_jobs = 1; nr_jobs <= max_jobs && !ret; nr_jobs *= 2)
+		ret = run_jobs(nr_jobs);
+
+	for (i = 0; i < max_jobs; i++) {
+		for (j = 0; j < nr_files; j++)
+			free(workers[i].files[j].file_name);
+		free(workers[i].files);
+	}
+	free(workers);
+
+	file_hash_exit();
+	scleanup();
+	return ret;
+}
@@ -0,0 +1,127 @@
+/*
+ * Measure the rate at which the buffer fill routines in lib/rand.c
+ * generate data, comparing the serial generator against the multi-lane
+ * one used by fill_random_buf(), and the compressible variant used for
+ * buffer_compress_percentage.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lib/rand.h"
+#include "../gettime.h"
+#include "../fio_time.h"
+
+#define DEF_BS		(128 * 1024)
+#define DEF_TOTAL_MB	4096
+
+struct fill_test {
+	const char *name;
+	void (*fn)(void *, unsigned int, uint64_t);
+};
+
+static void fill_serial(void *buf, unsigned int len, uint64_t seed)
+{
+	__fill_random_buf_serial(buf, len, seed);
+}
+
+static void fill_lanes(void *buf, unsigned int len, uint64_t seed)
+{
+	__fill_random_buf(buf, len, seed);
+}
+
+static void fill_compress50(void *buf, unsigned int len, uint64_t seed)
+{
+	__fill_random_buf_percentage(seed, buf, 50, 4096, len, NULL, 0);
+}
+
+static struct fill_test tests[] = {
+	{ .name = "serial",		.fn = fill_serial, },
+	{ .name = "lanes",		.fn = fill_lanes, },
+	{ .name = "compress=50",	.fn = fill_compress50, },
+	{ .name = NULL, },
+};
+
+static void usage(void)
+{
+	printf("Usage: fill-rand [bs] [total MiB]\n");
+	printf("bs:        size of each fill in bytes (default %u)\n", DEF_BS);
+	printf("total MiB: amount of data to generate per test (default %u)\n",
+		DEF_TOTAL_MB);
+}
+
+/*
+ * The same seed must always produce the same buffer, or dedupe and
+ * verify can't regenerate it.
+ */
+static int check_deterministic(struct fill_test *t, void *a, void *b,
+			       unsigned int bs)
+{
+	memset(a, 0x5a, bs);
+	memset(b, 0xa5, bs);
+	t->fn(a, bs, 0x8989);
+	t->fn(b, bs, 0x8989);
+
+	if (memcmp(a, b, bs)) {
+		printf("%s: output is not deterministic\n", t->name);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int bs = DEF_BS, total_mb = DEF_TOTAL_MB;
+	struct frand_state state;
+	uint64_t loops, i, usec;
+	struct timespec start;
+	void *buf, *cmp;
+	int j, ret = 0;
+
+	if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))) {
+		usage();
+		return 0;
+	}
+	if (argc > 1)
+		bs = atoi(argv[1]);
+	if (argc > 2)
+		total_mb = atoi(argv[2]);
+	if (!bs || !total_mb) {
+		usage();
+		return 1;
+	}
+
+	buf = malloc(bs);
+	cmp = malloc(bs);
+	if (!buf || !cmp) {
+		perror("malloc");
+		return 1;
+	}
+
+	init_rand_seed(&state, 0x8989, false);
+	loops = ((uint64_t) total_mb * 1024 * 1024) / bs;
+	if (!loops)
+		loops = 1;
+
+	for (j = 0; tests[j].name; j++) {
+		struct fill_test *t = &tests[j];
+
+		ret |= check_deterministic(t, buf, cmp, bs);
+
+		fio_gettime(&start, NULL);
+		for (i = 0; i < loops; i++)
+			t->fn(buf, bs, __get_next_seed(&state));
+		usec = utime_since_now(&start);
+
+		if (!usec)
+			usec = 1;
+		printf("%-12s %10.2f MiB/sec  %6.2f GB/sec\n", t->name,
+			(double) loops * bs / usec / 1.048576,
+			(double) loops * bs / (usec * 1000.0));
+	}
+
+	free(buf);
+	free(cmp);
+	return ret;
+}
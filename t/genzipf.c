@@ -8,6 +8,9 @@
  *
  *	./t/fio-genzipf -t zipf -i 1.2 -g 1 -b 4096 -o 20
  *
+ * With -B, compare the table based sampler with the pow() based one for
+ * speed, and for accuracy against the exact distribution.
+ *
  * Only the distribution type (zipf or pareto) and spread input need
  * to be given, if not given defaults are used.
  *
@@ -16,6 +19,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <math.h>
+#include <time.h>
 
 #include "../lib/zipf.h"
 #include "../lib/gauss.h"
@@ -54,6 +59,7 @@ static unsigned long output_nranges = DEF_NR_OUTPUT;
 static double percentage;
 static double dist_val;
 static int output_type = OUTPUT_NORMAL;
+static unsigned long bench_samples;
 
 #define DEF_ZIPF_VAL	1.2
 #define DEF_PARETO_VAL	0.3
@@ -99,11 +105,12 @@ static void usage(void)
 	printf("\t-g\tSize of data set (in gigabytes)\n");
 	printf("\t-o\tNumber of output rows\n");
 	printf("\t-c\tOutput ranges in CSV format\n");
+	printf("\t-B\tBenchmark the samplers, using this many millions of samples\n");
 }
 
 static int parse_options(int argc, char *argv[])
 {
-	const char *optstring = "t:g:i:o:b:p:ch";
+	const char *optstring = "t:g:i:o:b:p:B:ch";
 	int c, dist_val_set = 0;
 
 	while ((c = getopt(argc, argv, optstring)) != -1) {
@@ -142,6 +149,9 @@ static int parse_options(int argc, char *argv[])
 		case 'c':
 			output_type = OUTPUT_CSV;
 			break;
+		case 'B':
+			bench_samples = strtoul(optarg, NULL, 10) * 1000000UL;
+			break;
 		default:
 			printf("bad option %c\n", c);
 			return 1;
@@ -276,6 +286,159 @@ static void output_normal(struct node *nodes, unsigned long nnodes,
 	free(output_sums);
 }
 
+/*
+ * Ranks below BENCH_HEAD are checked one by one, the rest in
+ * BENCH_TAIL_BUCKETS log spaced buckets.
+ */
+#define BENCH_HEAD		1024
+#define BENCH_TAIL_BUCKETS	64
+
+static uint64_t bench_nr_buckets;
+static uint64_t bench_bucket_start[BENCH_HEAD + BENCH_TAIL_BUCKETS + 1];
+
+static void bench_setup_buckets(uint64_t nranges)
+{
+	uint64_t i, head = nranges < BENCH_HEAD ? nranges : BENCH_HEAD;
+	double step;
+
+	for (i = 0; i < head; i++)
+		bench_bucket_start[i] = i;
+	bench_nr_buckets = head;
+
+	if (head < nranges) {
+		step = log((double) nranges / head) / BENCH_TAIL_BUCKETS;
+		for (i = 1; i < BENCH_TAIL_BUCKETS; i++) {
+			uint64_t start = head * exp(step * i);
+
+			if (start > bench_bucket_start[bench_nr_buckets - 1])
+				bench_bucket_start[bench_nr_buckets++] = start;
+		}
+	}
+	bench_bucket_start[bench_nr_buckets] = nranges;
+}
+
+static unsigned int bench_bucket(uint64_t rank)
+{
+	unsigned int lo = 0, hi = bench_nr_buckets;
+
+	if (rank < BENCH_HEAD)
+		return rank;
+
+	while (hi - lo > 1) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (rank >= bench_bucket_start[mid])
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Sum of k^-theta for 1 based ranks [lo + 1, hi], exactly for the first
+ * ones and with the integral over [k - 0.5, k + 0.5] beyond.
+ */
+static double zipf_mass(uint64_t lo, uint64_t hi, double theta)
+{
+	double sum = 0.0;
+
+	for (; lo < hi && lo < BENCH_HEAD; lo++)
+		sum += pow(lo + 1, -theta);
+	if (lo < hi)
+		sum += (pow(hi + 0.5, 1.0 - theta) - pow(lo + 0.5, 1.0 - theta)) /
+			(1.0 - theta);
+
+	return sum;
+}
+
+static double pareto_cdf(uint64_t rank, uint64_t nranges, double h)
+{
+	double pareto_pow = log(h) / log(1.0 - h);
+	double v = (double) rank / (nranges - 1);
+
+	return v >= 1.0 ? 1.0 : pow(v, 1.0 / pareto_pow);
+}
+
+static double bench_exact(unsigned int i, uint64_t nranges)
+{
+	uint64_t lo = bench_bucket_start[i], hi = bench_bucket_start[i + 1];
+
+	if (dist_type == TYPE_ZIPF)
+		return zipf_mass(lo, hi, dist_val) /
+			zipf_mass(0, nranges, dist_val);
+
+	return pareto_cdf(hi, nranges, dist_val) -
+		pareto_cdf(lo, nranges, dist_val);
+}
+
+static void bench_one(const char *name, struct zipf_state *zs,
+		      uint64_t nranges)
+{
+	unsigned long *hits;
+	struct timespec s, e;
+	double secs, tv = 0.0;
+	unsigned long i;
+
+	hits = calloc(bench_nr_buckets, sizeof(*hits));
+
+	clock_gettime(CLOCK_MONOTONIC, &s);
+	for (i = 0; i < bench_samples; i++) {
+		uint64_t rank;
+
+		if (dist_type == TYPE_ZIPF)
+			rank = zipf_next(zs);
+		else
+			rank = pareto_next(zs);
+		hits[bench_bucket(rank)]++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &e);
+
+	secs = (e.tv_sec - s.tv_sec) + (e.tv_nsec - s.tv_nsec) / 1e9;
+	for (i = 0; i < bench_nr_buckets; i++)
+		tv += fabs((double) hits[i] / bench_samples - bench_exact(i, nranges));
+
+	printf("%-8s %8.2f Msamples/s   total variation %.5f   top rank %.4f%% (exact %.4f%%)\n",
+		name, bench_samples / secs / 1e6, tv / 2.0,
+		100.0 * hits[0] / bench_samples, 100.0 * bench_exact(0, nranges));
+	free(hits);
+}
+
+static int bench(uint64_t nranges)
+{
+	struct zipf_state zs;
+	struct timespec s, e;
+
+	if (dist_type == TYPE_NORMAL) {
+		printf("benchmark only supports zipf and pareto\n");
+		return 1;
+	}
+
+	bench_setup_buckets(nranges);
+
+	clock_gettime(CLOCK_MONOTONIC, &s);
+	if (dist_type == TYPE_ZIPF)
+		zipf_init(&zs, nranges, dist_val, 0.0, 1);
+	else
+		pareto_init(&zs, nranges, dist_val, 0.0, 1);
+	clock_gettime(CLOCK_MONOTONIC, &e);
+	zipf_disable_hash(&zs);
+	printf("table init %.2f msec\n", ((e.tv_sec - s.tv_sec) * 1e9 +
+		(e.tv_nsec - s.tv_nsec)) / 1e6);
+	bench_one("table", &zs, nranges);
+
+	clock_gettime(CLOCK_MONOTONIC, &s);
+	zipf_disable_table(&zs);
+	clock_gettime(CLOCK_MONOTONIC, &e);
+	printf("pow init %.2f msec\n", ((e.tv_sec - s.tv_sec) * 1e9 +
+		(e.tv_nsec - s.tv_nsec)) / 1e6);
+	bench_one("pow", &zs, nranges);
+
+	zipf_free(&zs);
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	unsigned long offset;
@@ -296,6 +459,9 @@ int main(int argc, char *argv[])
 	nranges = gib_size * 1024 * 1024 * 1024ULL;
 	nranges /= block_size;
 
+	if (bench_samples)
+		return bench(nranges);
+
 	if (dist_type == TYPE_ZIPF)
 		zipf_init(&zs, nranges, dist_val, -1, 1);
 	else if (dist_type == TYPE_PARETO)
@@ -0,0 +1,224 @@
+/*
+ * Stress and time smalloc: a number of processes (or threads) each build
+ * up a set of live allocations, churn through random free/allocate pairs
+ * and free everything again, like job setup and teardown with a large
+ * nrfiles does.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "../smalloc.h"
+#include "../arch/arch.h"
+#include "../os/os.h"
+#include "../lib/rand.h"
+#include "../fio_time.h"
+#include "../gettime.h"
+#include "debug.h"
+
+enum {
+	PHASE_ALLOC,
+	PHASE_CHURN,
+	PHASE_FREE,
+	PHASE_NR,
+};
+
+static const char *phase_names[PHASE_NR] = { "alloc", "churn", "free" };
+
+static unsigned int nr_workers = 4;
+static unsigned int nr_live = 50000;
+static unsigned int nr_churn = 200000;
+static unsigned int min_size = 16;
+static unsigned int max_size = 1024;
+static int use_threads;
+
+struct worker {
+	pthread_t thread;
+	unsigned int id;
+	int failed;
+	uint64_t usec[PHASE_NR];
+};
+
+static struct worker *workers;
+
+static unsigned int rand_size(struct frand_state *rs)
+{
+	return min_size + __rand(rs) % (max_size - min_size + 1);
+}
+
+static void *alloc_one(struct frand_state *rs, unsigned int *size)
+{
+	unsigned char *p;
+
+	*size = rand_size(rs);
+	p = smalloc(*size);
+	if (p) {
+		p[0] = *size;
+		p[*size - 1] = *size;
+	}
+	return p;
+}
+
+static int check_one(unsigned char *p, unsigned int size)
+{
+	return p[0] != (unsigned char) size ||
+		p[size - 1] != (unsigned char) size;
+}
+
+static void *worker_fn(void *data)
+{
+	struct worker *w = data;
+	struct frand_state rs;
+	unsigned int *sizes, i;
+	struct timespec start;
+	void **ptrs;
+
+	init_rand_seed(&rs, w->id + 1, false);
+	ptrs = calloc(nr_live, sizeof(void *));
+	sizes = calloc(nr_live, sizeof(unsigned int));
+
+	fio_gettime(&start, NULL);
+	for (i = 0; i < nr_live; i++) {
+		ptrs[i] = alloc_one(&rs, &sizes[i]);
+		if (!ptrs[i])
+			goto fail;
+	}
+	w->usec[PHASE_ALLOC] = utime_since_now(&start);
+
+	fio_gettime(&start, NULL);
+	for (i = 0; i < nr_churn; i++) {
+		unsigned int idx = __rand(&rs) % nr_live;
+
+		if (check_one(ptrs[idx], sizes[idx]))
+			goto fail;
+		sfree(ptrs[idx]);
+		ptrs[idx] = alloc_one(&rs, &sizes[idx]);
+		if (!ptrs[idx])
+			goto fail;
+	}
+	w->usec[PHASE_CHURN] = utime_since_now(&start);
+
+	fio_gettime(&start, NULL);
+	for (i = 0; i < nr_live; i++) {
+		if (check_one(ptrs[i], sizes[i]))
+			goto fail;
+		sfree(ptrs[i]);
+	}
+	w->usec[PHASE_FREE] = utime_since_now(&start);
+
+	free(ptrs);
+	free(sizes);
+	return NULL;
+fail:
+	fprintf(stderr, "worker %u: smalloc failed or corrupted\n", w->id);
+	w->failed = 1;
+	return NULL;
+}
+
+static void usage(const char *name)
+{
+	printf("%s: [-j workers] [-n live] [-c churn] [-s min] [-S max] [-t]\n",
+		name);
+	printf("\t-j\tNumber of workers (%u)\n", nr_workers);
+	printf("\t-n\tLive allocations per worker (%u)\n", nr_live);
+	printf("\t-c\tFree/allocate pairs per worker (%u)\n", nr_churn);
+	printf("\t-s\tMinimum allocation size (%u)\n", min_size);
+	printf("\t-S\tMaximum allocation size (%u)\n", max_size);
+	printf("\t-t\tUse threads instead of processes\n");
+}
+
+int main(int argc, char *argv[])
+{
+	uint64_t usec[PHASE_NR] = { 0, };
+	unsigned int i, j;
+	int c, ret = 0;
+
+	while ((c = getopt(argc, argv, "j:n:c:s:S:th")) != -1) {
+		switch (c) {
+		case 'j':
+			nr_workers = atoi(optarg);
+			break;
+		case 'n':
+			nr_live = atoi(optarg);
+			break;
+		case 'c':
+			nr_churn = atoi(optarg);
+			break;
+		case 's':
+			min_size = atoi(optarg);
+			break;
+		case 'S':
+			max_size = atoi(optarg);
+			break;
+		case 't':
+			use_threads = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!nr_workers || !nr_live || !min_size || min_size > max_size) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	arch_init(argv);
+	sinit();
+	debug_init();
+	fio_clock_init();
+
+	workers = mmap(NULL, nr_workers * sizeof(*workers),
+			PROT_READ | PROT_WRITE, OS_MAP_ANON | MAP_SHARED, -1, 0);
+	if (workers == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	memset(workers, 0, nr_workers * sizeof(*workers));
+
+	for (i = 0; i < nr_workers; i++) {
+		struct worker *w = &workers[i];
+
+		w->id = i;
+		if (use_threads) {
+			if (pthread_create(&w->thread, NULL, worker_fn, w)) {
+				perror("pthread_create");
+				return 1;
+			}
+		} else if (!fork()) {
+			worker_fn(w);
+			_exit(0);
+		}
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		if (use_threads)
+			pthread_join(workers[i].thread, NULL);
+		else
+			wait(NULL);
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		ret |= workers[i].failed;
+		for (j = 0; j < PHASE_NR; j++)
+			usec[j] += workers[i].usec[j];
+	}
+
+	for (j = 0; j < PHASE_NR; j++) {
+		uint64_t ops = (uint64_t) nr_workers *
+				(j == PHASE_CHURN ? nr_churn : nr_live);
+
+		printf("%s: %llu ops, %.1f nsec/op per worker\n",
+			phase_names[j], (unsigned long long) ops,
+			ops ? usec[j] * 1000.0 / ops : 0.0);
+	}
+
+	scleanup();
+	return ret;
+}
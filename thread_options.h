@@ -29,6 +29,8 @@ enum fio_memtype {
 	MEM_MMAPHUGE,	/* memory mapped huge file */
 	MEM_MMAPSHARED, /* use mmap with shared flag */
 	MEM_CUDA_MALLOC,/* use GPU memory */
+	MEM_MEMFDHUGE,	/* memfd_create() backed huge pages */
+	MEM_THP,	/* anonymous mmap with transparent huge pages */
 };
 
 /*
@@ -39,6 +41,15 @@ enum dedupe_mode {
 	DEDUPE_MODE_WORKING_SET = 1,
 };
 
+/*
+ * How a dedupe buffer differs from the buffer it was generated from
+ */
+enum dedupe_variant {
+	DEDUPE_VARIANT_EXACT = 0,
+	DEDUPE_VARIANT_SHIFTED = 1,
+	DEDUPE_VARIANT_SIMILAR = 2,
+};
+
 #define ERROR_STR_MAX	128
 
 #define BSSPLIT_MAX	64
@@ -130,6 +141,7 @@ struct thread_options {
 	unsigned int create_fsync;
 	unsigned int create_on_open;
 	unsigned int create_only;
+	unsigned int layout_threads;
 	unsigned int end_fsync;
 	unsigned int pre_read;
 	unsigned int sync_io;
@@ -186,6 +198,8 @@ struct thread_options {
 	fio_fp64_t random_center;
 
 	unsigned int random_generator;
+	unsigned int random_partition;
+	char *random_pattern;
 
 	unsigned int perc_rand[DDIR_RWDIR_CNT];
 
@@ -231,6 +245,7 @@ struct thread_options {
 	unsigned short numa_mem_mode;
 	unsigned int numa_mem_prefer_node;
 	char *numa_memnodes;
+	unsigned int numa_placement;
 	unsigned int gpu_dev_id;
 	unsigned int start_offset_percent;
 
@@ -252,9 +267,13 @@ struct thread_options {
 	unsigned int buffer_pattern_bytes;
 	unsigned int compress_percentage;
 	unsigned int compress_chunk;
+	unsigned int compress_mode;
+	unsigned int buffer_corpus;
 	unsigned int dedupe_percentage;
 	unsigned int dedupe_mode;
 	unsigned int dedupe_working_set_percentage;
+	unsigned int dedupe_variant;
+	unsigned int dedupe_similar_bits;
 	unsigned int time_based;
 	unsigned int disable_lat;
 	unsigned int disable_clat;
@@ -417,13 +436,13 @@ struct thread_options_pack {
 	uint32_t fill_device;
 	uint32_t file_append;
 	uint32_t unique_filename;
-	uint32_t pad3;
+	uint32_t layout_threads;
 	uint64_t file_size_low;
 	uint64_t file_size_high;
 	uint64_t start_offset;
 	uint64_t start_offset_align;
 	uint32_t start_offset_nz;
-	uint32_t pad4;
+	uint32_t numa_placement;
 
 	uint64_t bs[DDIR_RWDIR_CNT];
 	uint64_t ba[DDIR_RWDIR_CNT];
@@ -472,7 +491,8 @@ struct thread_options_pack {
 	uint32_t override_sync;
 	uint32_t rand_repeatable;
 	uint32_t allrand_repeatable;
-	uint32_t pad2;
+	uint32_t random_partition;
+	uint8_t random_pattern[FIO_TOP_STR_MAX];
 	uint64_t rand_seed;
 	uint32_t log_avg_msec;
 	uint32_t log_hist_msec;
@@ -565,9 +585,13 @@ struct thread_options_pack {
 	uint32_t buffer_pattern_bytes;
 	uint32_t compress_percentage;
 	uint32_t compress_chunk;
+	uint32_t compress_mode;
+	uint32_t buffer_corpus;
 	uint32_t dedupe_percentage;
 	uint32_t dedupe_mode;
 	uint32_t dedupe_working_set_percentage;
+	uint32_t dedupe_variant;
+	uint32_t dedupe_similar_bits;
 	uint32_t time_based;
 	uint32_t disable_lat;
 	uint32_t disable_clat;
@@ -41,10 +41,15 @@ void fill_buffer_pattern(struct thread_data *td, void *p, unsigned int len)
 	(void)cpy_pattern(td->o.buffer_pattern, td->o.buffer_pattern_bytes, p, len);
 }
 
-static void __fill_buffer(struct thread_options *o, uint64_t seed, void *p,
+static void __fill_buffer(struct thread_data *td, uint64_t seed, void *p,
 			  unsigned int len)
 {
-	__fill_random_buf_percentage(seed, p, o->compress_percentage, len, len, o->buffer_pattern, o->buffer_pattern_bytes);
+	struct thread_options *o = &td->o;
+
+	if (td->compress_pool.buf)
+		compress_pool_fill(&td->compress_pool, p, len, seed);
+	else
+		__fill_random_buf_percentage(seed, p, o->compress_percentage, len, len, o->buffer_pattern, o->buffer_pattern_bytes);
 }
 
 void fill_verify_pattern(struct thread_data *td, void *p, unsigned int len,
@@ -61,7 +66,7 @@ void fill_verify_pattern(struct thread_data *td, void *p, unsigned int len,
 				seed *= (unsigned long)__rand(&td->verify_state);
 		}
 		io_u->rand_seed = seed;
-		__fill_buffer(o, seed, p, len);
+		__fill_buffer(td, seed, p, len);
 		return;
 	}
 
@@ -1382,7 +1387,8 @@ void fio_verify_init(struct thread_data *td)
 	    td->o.verify == VERIFY_CRC32C) {
 		crc32c_arm64_probe();
 		crc32c_intel_probe();
-	}
+	} else if (td->o.verify == VERIFY_SHA256)
+		sha256_intel_probe();
 }
 
 static void *verify_async_thread(void *data)
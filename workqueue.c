@@ -13,13 +13,76 @@
 #include "pshared.h"
 
 enum {
-	SW_F_IDLE	= 1 << 0,
 	SW_F_RUNNING	= 1 << 1,
 	SW_F_EXIT	= 1 << 2,
 	SW_F_ACCOUNTED	= 1 << 3,
 	SW_F_ERROR	= 1 << 4,
 };
 
+/*
+ * Rounds an idle worker polls its ring before going to sleep. Only used
+ * if there's more than one CPU to poll on.
+ */
+#define WQ_SPIN		2000
+
+static void ring_init(struct workqueue_ring *ring)
+{
+	unsigned int i;
+
+	ring->head = ring->tail = 0;
+	for (i = 0; i < WQ_RING_SIZE; i++)
+		ring->slots[i].seq = i;
+}
+
+static bool ring_push(struct workqueue_ring *ring, struct workqueue_work *work)
+{
+	uint64_t pos = atomic_load_relaxed(&ring->tail);
+
+	do {
+		uint64_t seq;
+
+		seq = atomic_load_acquire(&ring->slots[pos % WQ_RING_SIZE].seq);
+		if (seq < pos)
+			return false;
+		if (seq > pos) {
+			pos = atomic_load_relaxed(&ring->tail);
+			continue;
+		}
+	} while (!atomic_compare_exchange_weak(
+			(_Atomic uint64_t *) &ring->tail, &pos, pos + 1));
+
+	ring->slots[pos % WQ_RING_SIZE].work = work;
+	atomic_store_release(&ring->slots[pos % WQ_RING_SIZE].seq, pos + 1);
+	return true;
+}
+
+static struct workqueue_work *ring_pop(struct workqueue_ring *ring)
+{
+	uint64_t pos = ring->head;
+	struct workqueue_work *work;
+
+	if (atomic_load_acquire(&ring->slots[pos % WQ_RING_SIZE].seq) != pos + 1)
+		return NULL;
+
+	work = ring->slots[pos % WQ_RING_SIZE].work;
+	atomic_store_release(&ring->slots[pos % WQ_RING_SIZE].seq,
+				pos + WQ_RING_SIZE);
+	ring->head = pos + 1;
+	return work;
+}
+
+static bool ring_empty(struct workqueue_ring *ring)
+{
+	uint64_t pos = ring->head;
+
+	return atomic_load_acquire(&ring->slots[pos % WQ_RING_SIZE].seq) != pos + 1;
+}
+
+static bool sw_has_work(struct submit_worker *sw)
+{
+	return !ring_empty(&sw->ring) || atomic_load_acquire(&sw->overflow);
+}
+
 static struct submit_worker *__get_submit_worker(struct workqueue *wq,
 						 unsigned int start,
 						 unsigned int end,
@@ -29,7 +92,7 @@ static struct submit_worker *__get_submit_worker(struct workqueue *wq,
 
 	while (start <= end) {
 		sw = &wq->workers[start];
-		if (sw->flags & SW_F_IDLE)
+		if (atomic_load_relaxed(&sw->idle))
 			return sw;
 		if (!(*best) || sw->seq < (*best)->seq)
 			*best = sw;
@@ -73,7 +136,7 @@ static bool all_sw_idle(struct workqueue *wq)
 	for (i = 0; i < wq->max_workers; i++) {
 		struct submit_worker *sw = &wq->workers[i];
 
-		if (!(sw->flags & SW_F_IDLE))
+		if (!atomic_load_acquire(&sw->idle))
 			return false;
 	}
 
@@ -97,6 +160,11 @@ void workqueue_flush(struct workqueue *wq)
 
 /*
  * Must be serialized by caller.
+ *
+ * Work goes into the worker's ring without taking any lock. Once the ring
+ * has filled up, work is added to the overflow list until the worker has
+ * drained it, so it's still handled in order. The worker is only woken if
+ * it went to sleep.
  */
 void workqueue_enqueue(struct workqueue *wq, struct workqueue_work *work)
 {
@@ -105,13 +173,26 @@ void workqueue_enqueue(struct workqueue *wq, struct workqueue_work *work)
 	sw = get_submit_worker(wq);
 	assert(sw);
 
-	pthread_mutex_lock(&sw->lock);
-	flist_add_tail(&work->list, &sw->work_list);
+	if (atomic_load_acquire(&sw->overflow) || !ring_push(&sw->ring, work)) {
+		pthread_mutex_lock(&sw->lock);
+		flist_add_tail(&work->list, &sw->work_list);
+		atomic_store_release(&sw->overflow, 1);
+		pthread_mutex_unlock(&sw->lock);
+	}
+
 	sw->seq = ++wq->work_seq;
-	sw->flags &= ~SW_F_IDLE;
 
-	pthread_cond_signal(&sw->cond);
-	pthread_mutex_unlock(&sw->lock);
+	/*
+	 * Pairs with the barrier in worker_thread(), either we see it going
+	 * to sleep, or it sees the new work.
+	 */
+	atomic_store_release(&sw->idle, 0);
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_relaxed(&sw->sleeping)) {
+		pthread_mutex_lock(&sw->lock);
+		pthread_cond_signal(&sw->cond);
+		pthread_mutex_unlock(&sw->lock);
+	}
 }
 
 static void handle_list(struct submit_worker *sw, struct flist_head *list)
@@ -126,11 +207,51 @@ static void handle_list(struct submit_worker *sw, struct flist_head *list)
 	}
 }
 
+static bool grab_ring(struct submit_worker *sw, struct flist_head *list)
+{
+	struct workqueue_work *work;
+	bool found = false;
+
+	while ((work = ring_pop(&sw->ring)) != NULL) {
+		flist_add_tail(&work->list, list);
+		found = true;
+	}
+
+	return found;
+}
+
+/*
+ * Grab everything queued so far. Whatever is in the ring when the overflow
+ * list is in use is older than the overflow work, so take that first.
+ */
+static bool grab_work(struct submit_worker *sw, struct flist_head *list)
+{
+	bool found;
+
+	found = grab_ring(sw, list);
+
+	if (atomic_load_acquire(&sw->overflow)) {
+		pthread_mutex_lock(&sw->lock);
+		grab_ring(sw, list);
+		flist_splice_tail_init(&sw->work_list, list);
+		atomic_store_release(&sw->overflow, 0);
+		pthread_mutex_unlock(&sw->lock);
+		found = true;
+	}
+
+	return found;
+}
+
+static bool sw_exiting(struct submit_worker *sw)
+{
+	return atomic_load_acquire(&sw->flags) & SW_F_EXIT;
+}
+
 static void *worker_thread(void *data)
 {
 	struct submit_worker *sw = data;
 	struct workqueue *wq = sw->wq;
-	unsigned int ret = 0;
+	unsigned int ret = 0, i;
 	FLIST_HEAD(local_list);
 
 	sk_out_assign(sw->sk_out);
@@ -158,53 +279,56 @@ static void *worker_thread(void *data)
 	if (sw->flags & SW_F_ERROR)
 		goto done;
 
-	pthread_mutex_lock(&sw->lock);
 	while (1) {
-		if (flist_empty(&sw->work_list)) {
-			if (sw->flags & SW_F_EXIT) {
-				break;
-			}
-
-			if (workqueue_pre_sleep_check(sw)) {
-				pthread_mutex_unlock(&sw->lock);
-				workqueue_pre_sleep(sw);
-				pthread_mutex_lock(&sw->lock);
-			}
+		if (grab_work(sw, &local_list)) {
+			handle_list(sw, &local_list);
+			if (wq->ops.update_acct_fn)
+				wq->ops.update_acct_fn(sw);
+			continue;
 		}
+
 		/*
-		 * We may have dropped and reaquired the lock, check state
-		 * again.
+		 * Work queued before the exit flag was set must still be
+		 * handled, so look again once we've seen it.
 		 */
-		if (flist_empty(&sw->work_list)) {
-			if (sw->flags & SW_F_EXIT) {
-				break;
-			}
-			if (!(sw->flags & SW_F_IDLE)) {
-				sw->flags |= SW_F_IDLE;
-				wq->next_free_worker = sw->index;
-				pthread_mutex_unlock(&sw->lock);
-				pthread_mutex_lock(&wq->flush_lock);
-				if (wq->wake_idle)
-					pthread_cond_signal(&wq->flush_cond);
-				pthread_mutex_unlock(&wq->flush_lock);
-				pthread_mutex_lock(&sw->lock);
-			}
+		if (sw_exiting(sw)) {
+			if (sw_has_work(sw))
+				continue;
+			break;
+		}
+
+		if (workqueue_pre_sleep_check(sw)) {
+			workqueue_pre_sleep(sw);
+			continue;
 		}
-		if (flist_empty(&sw->work_list)) {
-			if (sw->flags & SW_F_EXIT) {
-				break;
+
+		for (i = 0; i < wq->spin && !sw_has_work(sw); i++)
+			nop;
+		if (sw_has_work(sw))
+			continue;
+
+		if (!atomic_load_relaxed(&sw->idle)) {
+			atomic_store_release(&sw->idle, 1);
+			atomic_thread_fence(memory_order_seq_cst);
+			if (sw_has_work(sw)) {
+				atomic_store_release(&sw->idle, 0);
+				continue;
 			}
-			pthread_cond_wait(&sw->cond, &sw->lock);
-		} else {
-			flist_splice_init(&sw->work_list, &local_list);
+			wq->next_free_worker = sw->index;
+			pthread_mutex_lock(&wq->flush_lock);
+			if (wq->wake_idle)
+				pthread_cond_signal(&wq->flush_cond);
+			pthread_mutex_unlock(&wq->flush_lock);
 		}
-		pthread_mutex_unlock(&sw->lock);
-		handle_list(sw, &local_list);
-		if (wq->ops.update_acct_fn)
-			wq->ops.update_acct_fn(sw);
+
 		pthread_mutex_lock(&sw->lock);
+		atomic_store_release(&sw->sleeping, 1);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (!sw_has_work(sw) && !(sw->flags & SW_F_EXIT))
+			pthread_cond_wait(&sw->cond, &sw->lock);
+		atomic_store_release(&sw->sleeping, 0);
+		pthread_mutex_unlock(&sw->lock);
 	}
-	pthread_mutex_unlock(&sw->lock);
 
 done:
 	sk_out_drop();
@@ -276,6 +400,8 @@ static int start_worker(struct workqueue *wq, unsigned int index,
 	int ret;
 
 	INIT_FLIST_HEAD(&sw->work_list);
+	ring_init(&sw->ring);
+	sw->overflow = sw->sleeping = 0;
 
 	ret = mutex_cond_init_pshared(&sw->lock, &sw->cond);
 	if (ret)
@@ -291,13 +417,10 @@ static int start_worker(struct workqueue *wq, unsigned int index,
 			return ret;
 	}
 
+	atomic_store_release(&sw->idle, 1);
 	ret = pthread_create(&sw->thread, NULL, worker_thread, sw);
-	if (!ret) {
-		pthread_mutex_lock(&sw->lock);
-		sw->flags = SW_F_IDLE;
-		pthread_mutex_unlock(&sw->lock);
+	if (!ret)
 		return 0;
-	}
 
 	free_worker(sw, NULL);
 	return 1;
@@ -316,6 +439,7 @@ int workqueue_init(struct thread_data *td, struct workqueue *wq,
 	wq->ops = *ops;
 	wq->work_seq = 0;
 	wq->next_free_worker = 0;
+	wq->spin = cpus_online() > 1 ? WQ_SPIN : 0;
 
 	ret = mutex_cond_init_pshared(&wq->flush_lock, &wq->flush_cond);
 	if (ret)
@@ -14,11 +14,31 @@ struct workqueue_work {
 	struct flist_head list;
 };
 
+#define WQ_RING_SIZE	64
+
+/*
+ * Bounded multi producer, single consumer ring. A slot is free for the
+ * producer at position 'pos' when its seq is pos, and holds work for the
+ * consumer when it is pos + 1.
+ */
+struct workqueue_ring {
+	uint64_t tail;
+	uint64_t head;
+	struct {
+		uint64_t seq;
+		struct workqueue_work *work;
+	} slots[WQ_RING_SIZE];
+};
+
 struct submit_worker {
 	pthread_t thread;
 	pthread_mutex_t lock;
 	pthread_cond_t cond;
-	struct flist_head work_list;
+	struct workqueue_ring ring;
+	struct flist_head work_list;	/* overflow when the ring is full */
+	int overflow;
+	int idle;
+	int sleeping;
 	unsigned int flags;
 	unsigned int index;
 	uint64_t seq;
@@ -66,6 +86,7 @@ struct workqueue {
 	pthread_mutex_t flush_lock;
 	pthread_mutex_t stat_lock;
 	volatile int wake_idle;
+	unsigned int spin;
 };
 
 int workqueue_init(struct thread_data *td, struct workqueue *wq, struct workqueue_ops *ops, unsigned int max_workers, struct sk_out *sk_out);